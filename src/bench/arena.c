@@ -0,0 +1,68 @@
+#include "bench.h"
+
+// Building a line piece by piece the old way (an M_sappend, and a free, per piece) and with the string builder over an arena
+//   that's reset after each line, plus plain short-lived allocations from the heap and from the arena.
+
+#define HEAP_SZ (64ull * 1024 * 1024)
+#define ITERS 1000000
+
+static char* words[] = {"ls", " -l", " /some/path", " | grep", " something", " > out.txt"};
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    char mem[1024];
+    struct arena a;
+    initArena(&a, mem, sizeof(mem));
+
+    uint64_t sum = 0;
+
+    printf("%-34s %8s %8s\n", "", "cycles", "allocs");
+
+    BENCH_ALLOCS("line via M_sappend chain", {
+        char* s = M_scopy("");
+        for (uint64_t w = 0; w < WORDS; w++) {
+            char* t = M_sappend(s, words[w]);
+            free(s);
+            s = t;
+        }
+        sum += strlen(s);
+        free(s);
+    });
+
+    BENCH_ALLOCS("line via builder in arena", {
+        struct arena_mark m = arenaMark(&a);
+        struct sbuf b;
+        sbInitArena(&b, &a, 16);
+        for (uint64_t w = 0; w < WORDS; w++)
+            sbAppend(&b, words[w]);
+        sum += b.len;
+        arenaReset(&a, m);
+    });
+
+    BENCH_ALLOCS("4 x 80-byte temporaries, heap", {
+        char* t[4];
+        for (int j = 0; j < 4; j++)
+            sum += (uint64_t) (t[j] = malloc(80));
+        for (int j = 0; j < 4; j++)
+            free(t[j]);
+    });
+
+    BENCH_ALLOCS("4 x 80-byte temporaries, arena", {
+        struct arena_mark m = arenaMark(&a);
+        for (int j = 0; j < 4; j++)
+            sum += (uint64_t) arenaAlloc(&a, 80);
+        arenaReset(&a, m);
+    });
+
+    BENCH_ALLOCS("2 KiB line, arena past its buffer", {
+        struct arena_mark m = arenaMark(&a);
+        sum += (uint64_t) arenaAlloc(&a, 2048);
+        arenaReset(&a, m);
+    });
+
+    printf("\narena chunks malloc'd over all of that: %lu\n", a.grows);
+
+    return sum == 0;
+}
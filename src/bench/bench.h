@@ -0,0 +1,114 @@
+#pragma once
+
+// Host-side benchmarks.  The Makefile builds src/lib for the host and prefixes every symbol in it with pos_, so these can use
+//   libc for output and timing while exercising our code; the defines below let them call our functions by their usual names.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <x86intrin.h>
+
+#define init_heap pos_init_heap
+#define malloc pos_malloc
+#define mallocz pos_mallocz
+#define free pos_free
+#define realloc pos_realloc
+#define reallocz pos_reallocz
+#define heapUsed pos_heapUsed
+#define heapSize pos_heapSize
+#define getHeapStats pos_getHeapStats
+
+#define newList pos_newList
+#define pushListTail pos_pushListTail
+#define popListHead pos_popListHead
+#define removeNodeFromList pos_removeNodeFromList
+#define forEachListItem pos_forEachListItem
+
+#define pushIListHead pos_pushIListHead
+#define pushIListTail pos_pushIListTail
+#define popIListHead pos_popIListHead
+#define removeFromIList pos_removeFromIList
+#define nextINodeCirc pos_nextINodeCirc
+
+#define rbInsertColor pos_rbInsertColor
+#define rbErase pos_rbErase
+#define rbFirst pos_rbFirst
+#define rbLast pos_rbLast
+#define rbNext pos_rbNext
+#define rbPrev pos_rbPrev
+
+#define newPidTable pos_newPidTable
+#define pidTableLen pos_pidTableLen
+#define pidTableAdd pos_pidTableAdd
+#define pidTableGet pos_pidTableGet
+#define pidTableRemove pos_pidTableRemove
+
+#define memcpy pos_memcpy
+#define memmove pos_memmove
+#define memset pos_memset
+#define memset16 pos_memset16
+
+#define initArena pos_initArena
+#define arenaAlloc pos_arenaAlloc
+#define arenaRealloc pos_arenaRealloc
+#define arenaMark pos_arenaMark
+#define arenaReset pos_arenaReset
+#define freeArena pos_freeArena
+#define sbInit pos_sbInit
+#define sbInitArena pos_sbInitArena
+#define sbAppend pos_sbAppend
+#define sbAppendN pos_sbAppendN
+#define sbAppendChar pos_sbAppendChar
+#define sbPrintf pos_sbPrintf
+#define sbVprintf pos_sbVprintf
+
+#define sprintf pos_sprintf
+#define M_sprintf pos_M_sprintf
+#define M_sappend pos_M_sappend
+#define M_scopy pos_M_scopy
+#define strlen pos_strlen
+#define strcmp pos_strcmp
+
+#include "../lib/arena.h"
+#include "../lib/ilist.h"
+#include "../lib/list.h"
+#include "../lib/malloc.h"
+#include "../lib/mem.h"
+#include "../lib/min_heap.h"
+#include "../lib/pid_table.h"
+#include "../lib/rbtree.h"
+#include "../lib/strings.h"
+#include "../lib/vector.h"
+
+static inline uint64_t cycles() {
+    _mm_lfence();
+    return __rdtsc();
+}
+
+// Host memory for a heap of our own; never given back, as benchmarks are short-lived
+static inline uint64_t* host_region(uint64_t size) {
+    return aligned_alloc(2 * 1024 * 1024, size);
+}
+
+// Runs stmt ITERS times (i is the iteration), after a tenth as many to warm up, and prints cycles per iteration
+#define BENCH(name, stmt) do {                                  \
+        for (uint64_t i = 0; i < ITERS / 10; i++)               \
+            stmt;                                               \
+        uint64_t start = cycles();                              \
+        for (uint64_t i = 0; i < ITERS; i++)                    \
+            stmt;                                               \
+        printf("%-44s %8lu\n", name, (cycles() - start) / ITERS); \
+    } while (0)
+
+// Runs stmt ITERS times (i is the iteration) and prints cycles and heap allocations per iteration
+#define BENCH_ALLOCS(name, stmt) do {                                                                \
+        struct heap_stats before, after;                                                             \
+        getHeapStats(&before);                                                                       \
+        uint64_t start = cycles();                                                                   \
+        for (uint64_t i = 0; i < ITERS; i++) {                                                       \
+            stmt;                                                                                    \
+        }                                                                                            \
+        uint64_t c = (cycles() - start) / ITERS;                                                     \
+        getHeapStats(&after);                                                                        \
+        printf("%-34s %8lu %8.2f\n", name, c, (double) (after.total_allocs - before.total_allocs) / ITERS); \
+    } while (0)
@@ -0,0 +1,106 @@
+#include "bench.h"
+
+// Walking N items with forEachListItem and a callback (as log.c and keyboard.c used to, though they passed nested functions, which
+//   need an executable stack for their trampolines and so won't even run here) against the same walk over a vector and an
+//   intrusive list, where the loop body inlines; then per-operation costs of the min-heap and red-black tree.
+
+#define HEAP_SZ (64ull * 1024 * 1024)
+#define N 1000
+#define WALKS 10000
+#define OPS 1000000
+
+struct item {
+    uint64_t key;
+    struct ilist_node node;
+    struct rb_node rb;
+};
+
+static struct item items[N];
+
+#define itemKey(i) ((i)->key)
+DEFINE_RBTREE(item_tree, struct item, rb, uint64_t, itemKey)
+
+#define itemLess(a, b) ((a)->key < (b)->key)
+DEFINE_MIN_HEAP(item_heap, struct item*, itemLess, MIN_HEAP_UNINDEXED)
+
+DEFINE_VECTOR(item_vec, struct item*)
+
+static uint64_t sum = 0;
+
+static void addKey(void* item) {
+    sum += ((struct item*) item)->key;
+}
+
+static uint64_t rand_state = 88172645463325252ull;
+static uint64_t xorshift() {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return rand_state;
+}
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    struct list* l = newList();
+    struct ilist il = {0};
+    struct item_vec v = {0};
+    for (uint64_t i = 0; i < N; i++) {
+        items[i].key = xorshift() % (N * 4);
+        pushListTail(l, &items[i]);
+        pushIListTail(&il, &items[i].node);
+        item_vecPush(&v, &items[i]);
+    }
+
+    printf("Cycles per item, walking %u items and summing keys\n", N);
+
+    uint64_t start = cycles();
+    for (uint64_t w = 0; w < WALKS; w++)
+        forEachListItem(l, addKey);
+    printf("  list + callback         %6.2f\n", (double) (cycles() - start) / WALKS / N);
+
+    start = cycles();
+    for (uint64_t w = 0; w < WALKS; w++)
+        iListForEachItem(it, &il, struct item, node)
+            sum += it->key;
+    printf("  ilist                   %6.2f\n", (double) (cycles() - start) / WALKS / N);
+
+    start = cycles();
+    for (uint64_t w = 0; w < WALKS; w++)
+        vecForEach(it, &v)
+            sum += (*it)->key;
+    printf("  vector                  %6.2f\n", (double) (cycles() - start) / WALKS / N);
+
+    // Steady state at N items: pop the smallest, push something new
+    struct item_heap h = {0};
+    for (uint64_t i = 0; i < N; i++)
+        item_heapPush(&h, &items[i]);
+
+    start = cycles();
+    for (uint64_t i = 0; i < OPS; i++) {
+        struct item* it = item_heapPop(&h);
+        it->key += xorshift() % (N * 4);
+        item_heapPush(&h, it);
+    }
+    printf("\nmin-heap of %u: %lu cycles per pop+push\n", N, (cycles() - start) / OPS);
+
+    struct rb_root t = {0};
+    for (uint64_t i = 0; i < N; i++)
+        item_treeInsert(&t, &items[i]);
+
+    start = cycles();
+    for (uint64_t i = 0; i < OPS; i++) {
+        struct item* it = &items[xorshift() % N];
+        rbErase(&t, &it->rb);
+        it->key = xorshift() % (N * 4);
+        item_treeInsert(&t, it);
+    }
+    printf("rbtree of %u:   %lu cycles per erase+insert\n", N, (cycles() - start) / OPS);
+
+    start = cycles();
+    for (uint64_t i = 0; i < OPS; i++)
+        sum += (uint64_t) item_treeFind(&t, items[xorshift() % N].key);
+    printf("rbtree of %u:   %lu cycles per find\n", N, (cycles() - start) / OPS);
+
+    return sum == 0;
+}
@@ -0,0 +1,25 @@
+#include "bench.h"
+
+// Formatting cost: the status bar clock line and a log-style line with big numbers, into a stack buffer and into the heap, with
+//   the heap allocations each makes.
+
+#define HEAP_SZ (64ull * 1024 * 1024)
+#define ITERS 1000000
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    char buf[128];
+    uint64_t sum = 0;
+
+    printf("%-34s %8s %8s\n", "", "cycles", "allocs");
+
+    BENCH_ALLOCS("clock, stack buffer", sum += strlen(sprintf(buf, sizeof(buf), "%p 2u:%p02u:%p02u.%p03u %s", i % 12, i % 60,
+                                                             i % 59, i % 1000, "PM")));
+    BENCH_ALLOCS("clock, M_sprintf", char* s = M_sprintf("%p 2u:%p02u:%p02u.%p03u %s", i % 12, i % 60, i % 59, i % 1000, "PM");
+                                     sum += strlen(s); free(s));
+    BENCH_ALLOCS("3 x 64-bit %u + %h, stack buffer", sum += strlen(sprintf(buf, sizeof(buf), "%u %u %u 0x%p016h", i * 0x9e3779b97f4a7c15ull,
+                                                                          -i, i << 32, i)));
+
+    return sum == 0;
+}
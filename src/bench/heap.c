@@ -0,0 +1,64 @@
+#include "bench.h"
+
+// Allocation latency against heap occupancy: the heap is filled (low to high, so any linear search has to walk everything used
+//   so far) to each level, then we time malloc/free pairs of a few sizes at that level.
+
+#define HEAP_SZ (1024ull * 1024 * 1024)
+#define FILL_SZ (16 * 1024)
+#define ITERS 20000
+
+static const uint64_t sizes[] = {64, 2000, 64 * 1024};
+static const uint64_t levels[] = {0, 10, 25, 50, 75, 90, 95};
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    printf("Heap: %lu MB; cycles per malloc+free pair\n\n", heapSize() / 1024 / 1024);
+    printf("occupancy");
+    for (uint64_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        printf(" %10lu B", sizes[s]);
+    printf("\n");
+
+    uint64_t filled = 0;
+    for (uint64_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        for (; filled * 100 < heapSize() * levels[l]; filled += FILL_SZ)
+            if (!malloc(FILL_SZ))
+                break;
+
+        printf("%8lu%%", heapUsed() * 100 / heapSize());
+
+        for (uint64_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint64_t start = cycles();
+            for (uint64_t i = 0; i < ITERS; i++)
+                free(malloc(sizes[s]));
+
+            printf(" %12lu", (cycles() - start) / ITERS);
+        }
+        printf("\n");
+    }
+
+    // Growing a buffer by doubling, like M_vsprintf does; with room after it, this shouldn't copy at all past the slab sizes
+    struct heap_stats before, after;
+    getHeapStats(&before);
+    uint64_t start = cycles();
+    for (uint64_t i = 0; i < ITERS / 10; i++) {
+        void* p = malloc(64);
+        for (uint64_t sz = 128; sz <= 64 * 1024; sz *= 2)
+            p = realloc(p, sz);
+        free(p);
+    }
+    getHeapStats(&after);
+    printf("\nDoubling 64 B to 64 K: %lu cycles; %lu reallocs in place, %lu moved, %lu bytes copied per buffer\n",
+           (cycles() - start) / (ITERS / 10), (after.reallocs_in_place - before.reallocs_in_place) / (ITERS / 10),
+           (after.reallocs_moved - before.reallocs_moved) / (ITERS / 10), (after.realloc_copied - before.realloc_copied) / (ITERS / 10));
+
+    // Reading the accounting shouldn't depend on how big or full the heap is
+    struct heap_stats hs;
+    start = cycles();
+    for (uint64_t i = 0; i < ITERS; i++)
+        getHeapStats(&hs);
+    printf("\ngetHeapStats(): %lu cycles; fragmentation %lu.%lu%%, largest free run %lu K, %lu live allocations\n",
+           (cycles() - start) / ITERS, hs.frag / 10, hs.frag % 10, hs.largest_free / 1024, hs.allocs);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#include <time.h>
+
+#include "../lib/syscall.h"
+
+// What reading the kernel data page saves over asking with a syscall.  The host's own int 0x80 (its 32-bit syscall gate, still
+//   there on most x86-64 kernels) stands in for ours: the same trap into ring 0 and iretq back, with next to nothing done in
+//   between.  The page reads are sys.c's getPid and clockGettime, against a page filled in the way clock.c's publish does it.
+
+#define ITERS 1000000
+#define I386_GETPID 20
+
+static struct sc_kdata page;
+
+static uint64_t trapGetpid() {
+    uint64_t r;
+    asm volatile("int $0x80" : "=a"(r) : "a"((uint64_t) I386_GETPID) : "rcx", "r11", "memory");
+    return r;
+}
+
+static uint64_t pageGetpid() {
+    return ((volatile struct sc_kdata*) &page)->pid;
+}
+
+static uint64_t pageClock() {
+    struct sc_kdata* kd = &page;
+    uint64_t s, ns;
+
+    do {
+        s = __atomic_load_n(&kd->seq, __ATOMIC_ACQUIRE);
+        ns = kd->clock_ns + (((unsigned __int128) (cycles() - kd->clock_tsc) * kd->clock_mult) >> 32);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (s != __atomic_load_n(&kd->seq, __ATOMIC_ACQUIRE));
+
+    return ns;
+}
+
+static uint64_t hostNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main() {
+    // Calibrate the TSC roughly, so the page's clock reads something sensible (the cost doesn't depend on it)
+    uint64_t n0 = hostNs(), t0 = cycles();
+    while (hostNs() - n0 < 20000000)
+        ;
+    uint64_t tsc_hz = (cycles() - t0) * 1000000000ull / (hostNs() - n0);
+
+    page.pid = 1;
+    page.clock_mult = (1000000000ull << 32) / tsc_hz;
+    page.clock_tsc = cycles();
+
+    volatile uint64_t sink;
+    (void) sink;
+
+    printf("%-44s %8s\n", "", "cycles");
+
+    if (trapGetpid() == (uint64_t) -38) // -ENOSYS: no 32-bit gate on this host
+        printf("%-44s %8s\n", "getpid, int 0x80", "n/a");
+    else
+        BENCH("getpid, int 0x80", sink = trapGetpid());
+    BENCH("getpid, kernel data page", sink = pageGetpid());
+    BENCH("monotonic clock, kernel data page", sink = pageClock());
+    BENCH("rdtsc alone (lfence; rdtsc)", sink = cycles());
+
+    return 0;
+}
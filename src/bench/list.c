@@ -0,0 +1,78 @@
+#include "bench.h"
+
+// Scheduler-shaped list traffic: a run queue of NPROCS processes, where each step takes the head and requeues it at the tail (a
+//   timeslice ending), and every so often one process blocks (unlinked from the middle) and wakes again (pushed on the tail).
+//   Run once with the allocating list and once with the intrusive one, counting heap allocations made along the way.
+
+#define HEAP_SZ (64ull * 1024 * 1024)
+#define NPROCS 64
+#define ITERS 1000000
+#define BLOCK_EVERY 8
+
+struct proc {
+    uint64_t pid;
+    void* node;
+    struct ilist_node run_node;
+};
+
+static struct proc procs[NPROCS];
+
+static void report(const char* name, uint64_t start, struct heap_stats* before) {
+    uint64_t c = cycles() - start;
+    struct heap_stats after;
+    getHeapStats(&after);
+
+    printf("%-10s %6lu cycles per step, %8lu heap allocations, %lu still live\n", name, c / ITERS,
+           after.total_allocs - before->total_allocs, after.allocs - before->allocs);
+}
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    struct heap_stats before;
+    uint64_t sum = 0;
+
+    struct list* rq = newList();
+    for (uint64_t i = 0; i < NPROCS; i++) {
+        procs[i].pid = i;
+        procs[i].node = pushListTail(rq, &procs[i]);
+    }
+
+    getHeapStats(&before);
+    uint64_t start = cycles();
+    for (uint64_t i = 0; i < ITERS; i++) {
+        struct proc* p = popListHead(rq);
+        sum += p->pid;
+        p->node = pushListTail(rq, p);
+
+        if (i % BLOCK_EVERY == 0) {
+            struct proc* b = &procs[i / BLOCK_EVERY % NPROCS];
+            removeNodeFromList(rq, b->node);
+            b->node = pushListTail(rq, b);
+        }
+    }
+    report("list", start, &before);
+    while (popListHead(rq))
+        ;
+
+    struct ilist irq = {0};
+    for (uint64_t i = 0; i < NPROCS; i++)
+        pushIListTail(&irq, &procs[i].run_node);
+
+    getHeapStats(&before);
+    start = cycles();
+    for (uint64_t i = 0; i < ITERS; i++) {
+        struct proc* p = iListItem(popIListHead(&irq), struct proc, run_node);
+        sum += p->pid;
+        pushIListTail(&irq, &p->run_node);
+
+        if (i % BLOCK_EVERY == 0) {
+            struct proc* b = &procs[i / BLOCK_EVERY % NPROCS];
+            removeFromIList(&b->run_node);
+            pushIListTail(&irq, &b->run_node);
+        }
+    }
+    report("ilist", start, &before);
+
+    return sum == 0; // Keeps the loops from being optimized away
+}
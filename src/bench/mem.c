@@ -0,0 +1,76 @@
+#include "bench.h"
+
+// Our memory and string primitives against the byte/qword loops they replaced, across sizes.  The loops are kept from being
+//   turned into libc calls, so this compares like with like.
+
+#define LOOP __attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+#define BUF_SZ (2 * 1024 * 1024)
+
+static const uint64_t sizes[] = {16, 64, 256, 3840, 64 * 1024, 2 * 1024 * 1024};
+static const uint64_t str_sizes[] = {8, 64, 1000};
+
+LOOP static void loopCopy(uint64_t* d, uint64_t* s, uint64_t n) {
+    for (uint64_t i = 0; i < n / 8; i++)
+        d[i] = s[i];
+}
+
+LOOP static void loopFill(uint64_t* d, uint64_t n) {
+    for (uint64_t i = 0; i < n / 8; i++)
+        d[i] = 0;
+}
+
+LOOP static uint64_t loopStrlen(char* s) {
+    uint64_t i = 0;
+    while (s[i]) i++;
+    return i;
+}
+
+LOOP static int loopStrcmp(char* s, char* t) {
+    for (uint64_t i = 0;; i++) {
+        int d;
+        if ((d = s[i] - t[i]))
+            return d;
+        if (!s[i])
+            return 0;
+    }
+}
+
+#define TIME(total, stmt) ({                                \
+    uint64_t __iters__ = (total);                           \
+    uint64_t __start__ = cycles();                          \
+    for (uint64_t __i__ = 0; __i__ < __iters__; __i__++) {  \
+        stmt;                                               \
+        __asm__ __volatile__("" ::: "memory");              \
+    }                                                       \
+    (double) (cycles() - __start__) / __iters__;            \
+})
+
+int main() {
+    uint8_t* a = (uint8_t*) host_region(BUF_SZ);
+    uint8_t* b = (uint8_t*) host_region(BUF_SZ);
+    memset(a, 1, BUF_SZ);
+    memset(b, 2, BUF_SZ);
+
+    printf("Cycles per call, old loop vs ours\n\n%10s %12s %12s %12s %12s\n", "bytes", "loop copy", "memcpy", "loop fill",
+           "memset");
+    for (uint64_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint64_t n = sizes[i], iters = 64 * 1024 * 1024 / n + 16;
+        printf("%10lu %12.1f %12.1f %12.1f %12.1f\n", n, TIME(iters, loopCopy((uint64_t*) a, (uint64_t*) b, n)),
+               TIME(iters, memcpy(a, b, n)), TIME(iters, loopFill((uint64_t*) a, n)), TIME(iters, memset(a, 0, n)));
+    }
+
+    printf("\n%10s %12s %12s %12s %12s\n", "chars", "loop strlen", "strlen", "loop strcmp", "strcmp");
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < sizeof(str_sizes) / sizeof(str_sizes[0]); i++) {
+        uint64_t n = str_sizes[i];
+        memset(a, 'x', n);
+        memset(b, 'x', n);
+        a[n] = b[n] = 0;
+
+        printf("%10lu %12.1f %12.1f %12.1f %12.1f\n", n, TIME(1000000, sum += loopStrlen((char*) a)),
+               TIME(1000000, sum += strlen((char*) a)), TIME(1000000, sum += loopStrcmp((char*) a, (char*) b + 0)),
+               TIME(1000000, sum += strcmp((char*) a, (char*) b)));
+    }
+
+    return sum == 0;
+}
@@ -0,0 +1,62 @@
+#include "bench.h"
+
+// Pid lookup cost as the number of live processes grows.  At each size the table has been through plenty of churn (processes
+//   exiting in a scattered order and new ones taking fresh pids), so it looks like a long-running system, not a freshly filled one.
+
+#define HEAP_SZ (64ull * 1024 * 1024)
+#define MAX_PID (1 << 16) // Small enough that churn wraps pids around and exercises recycling
+#define LOOKUPS 1000000
+
+static const uint64_t sizes[] = {10, 100, 1000, 10000, 50000};
+
+static uint64_t live[50000];
+
+static uint64_t rand_state = 88172645463325252ull;
+static uint64_t xorshift() {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return rand_state;
+}
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+    struct pid_table* t = newPidTable(MAX_PID);
+
+    printf("%8s %14s %14s %14s\n", "live", "lookup", "add+remove", "missing");
+
+    uint64_t n = 0, sum = 0;
+    for (uint64_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (; n < sizes[s]; n++)
+            live[n] = pidTableAdd(t, &live[n]);
+
+        // Churn: a random live process exits and a new one takes its place
+        uint64_t start = cycles();
+        for (uint64_t i = 0; i < LOOKUPS / 10; i++) {
+            uint64_t j = xorshift() % n;
+            pidTableRemove(t, live[j]);
+            live[j] = pidTableAdd(t, &live[j]);
+        }
+        uint64_t churn = (cycles() - start) / (LOOKUPS / 10);
+
+        start = cycles();
+        for (uint64_t i = 0; i < LOOKUPS; i++)
+            sum += (uint64_t) pidTableGet(t, live[xorshift() % n]);
+        uint64_t hit = (cycles() - start) / LOOKUPS;
+
+        start = cycles();
+        for (uint64_t i = 0; i < LOOKUPS; i++)
+            sum += (uint64_t) pidTableGet(t, xorshift() % (MAX_PID * 2) + MAX_PID); // Never handed out
+        uint64_t miss = (cycles() - start) / LOOKUPS;
+
+        for (uint64_t i = 0; i < n; i++)
+            if (pidTableGet(t, live[i]) != &live[i]) {
+                printf("pid %lu maps to the wrong process!\n", live[i]);
+                return 1;
+            }
+
+        printf("%8lu %14lu %14lu %14lu\n", pidTableLen(t), hit, churn, miss);
+    }
+
+    return sum == 0;
+}
@@ -0,0 +1,158 @@
+#include "bench.h"
+
+// What one preemption costs in switching alone, the way the kernel used to do it and the way it does now, leaving out everything
+//   both share (the timer interrupt itself, the page-table switch, waitloop's choice of who runs next).  iretq works fine at the
+//   same privilege level, so both run here in user mode with the kernel's own instructions; the old path's C parts are written out
+//   as the straight-line moves they'd be at best.
+//
+// Old: irq0 saved 15 registers into the global regs[]; irq0_pit copied them, and rip/rsp/rflags, into struct process; then
+//   iretqWaitloop iretq'd into waitloop, whose startProc built a 20-qword iretq frame on the user stack from struct process, popped
+//   it and iretq'd back.
+// New: irq0 pushes 15 registers onto the process's kernel stack after the CPU's frame; irq0_pit switches stacks to waitloop, which
+//   (standing in for picking the same process again) switches right back; irq0 pops them and iretqs.
+
+#define ITERS 1000000
+#define SCHED_STACK 16384
+
+uint64_t old_regs[15];
+uint64_t old_proc[18]; // 15 registers, rip, rsp, rflags, laid out like struct process was
+uint64_t proc_ksp, sched_ksp;
+
+void old_switch();
+void new_switch();
+void bench_switch_stacks(uint64_t* save_sp, uint64_t sp);
+
+#define SAVE_REG(i, r) "mov %" #r ", old_regs+" #i "*8(%rip)\n"
+#define COPY_REG(i) "mov " #i "*8(%rsi), %rax\nmov %rax, " #i "*8(%rdi)\n"
+#define BUILD_REG(i) "mov " #i "*8(%rdi), %rax\nmov %rax, -(6+" #i ")*8(%rsi)\n"
+
+#define FAKE_INTERRUPT(to)  \
+    "mov %rsp, %rax\n"      \
+    "mov %ss, %ecx\n"       \
+    "push %rcx\n"           \
+    "push %rax\n"           \
+    "pushfq\n"              \
+    "mov %cs, %ecx\n"       \
+    "push %rcx\n"           \
+    "lea " to "(%rip), %rcx\n" \
+    "push %rcx\n"
+
+#define PUSH_CALLEE_SAVED "push %rbx\npush %rbp\npush %r12\npush %r13\npush %r14\npush %r15\n"
+#define POP_CALLEE_SAVED "pop %r15\npop %r14\npop %r13\npop %r12\npop %rbp\npop %rbx\n"
+#define PUSH_REGS "push %rax\npush %rbx\npush %rcx\npush %rdx\npush %rsi\npush %rdi\npush %rbp\npush %r8\npush %r9\npush %r10\n" \
+    "push %r11\npush %r12\npush %r13\npush %r14\npush %r15\n"
+#define POP_REGS "pop %r15\npop %r14\npop %r13\npop %r12\npop %r11\npop %r10\npop %r9\npop %r8\npop %rbp\npop %rdi\npop %rsi\n" \
+    "pop %rdx\npop %rcx\npop %rbx\npop %rax\n"
+
+asm(
+    ".text\n"
+
+    "old_switch:\n"
+    PUSH_CALLEE_SAVED
+    FAKE_INTERRUPT("9f")
+    "call old_save_regs\n"
+
+    // irq0_pit: regs[] and the interrupt frame into struct process
+    "lea old_regs(%rip), %rsi\n"
+    "lea old_proc(%rip), %rdi\n"
+    COPY_REG(0) COPY_REG(1) COPY_REG(2) COPY_REG(3) COPY_REG(4) COPY_REG(5) COPY_REG(6) COPY_REG(7)
+    COPY_REG(8) COPY_REG(9) COPY_REG(10) COPY_REG(11) COPY_REG(12) COPY_REG(13) COPY_REG(14)
+    "mov 0(%rsp), %rax\n"
+    "mov %rax, 15*8(%rdi)\n"
+    "mov 24(%rsp), %rax\n"
+    "mov %rax, 16*8(%rdi)\n"
+    "mov 16(%rsp), %rax\n"
+    "mov %rax, 17*8(%rdi)\n"
+
+    // iretqWaitloop
+    FAKE_INTERRUPT("1f")
+    "iretq\n"
+
+    // startProc: the iretq frame, then the registers, below the saved user rsp
+    "1:\n"
+    "lea old_proc(%rip), %rdi\n"
+    "mov 16*8(%rdi), %rsi\n"
+    "mov %ss, %ecx\n"
+    "mov %rcx, -8(%rsi)\n"
+    "mov %rsi, -16(%rsi)\n"
+    "mov 17*8(%rdi), %rax\n"
+    "or $0x200, %rax\n"
+    "mov %rax, -24(%rsi)\n"
+    "mov %cs, %ecx\n"
+    "mov %rcx, -32(%rsi)\n"
+    "mov 15*8(%rdi), %rax\n"
+    "mov %rax, -40(%rsi)\n"
+    BUILD_REG(0) BUILD_REG(1) BUILD_REG(2) BUILD_REG(3) BUILD_REG(4) BUILD_REG(5) BUILD_REG(6) BUILD_REG(7)
+    BUILD_REG(8) BUILD_REG(9) BUILD_REG(10) BUILD_REG(11) BUILD_REG(12) BUILD_REG(13) BUILD_REG(14)
+    "lea -20*8(%rsi), %rsp\n"
+    POP_REGS
+    "iretq\n"
+
+    "9:\n"
+    POP_CALLEE_SAVED
+    "ret\n"
+
+    "old_save_regs:\n"
+    SAVE_REG(0, rax) SAVE_REG(1, rbx) SAVE_REG(2, rcx) SAVE_REG(3, rdx) SAVE_REG(4, rsi) SAVE_REG(5, rdi) SAVE_REG(6, rbp)
+    SAVE_REG(7, r8) SAVE_REG(8, r9) SAVE_REG(9, r10) SAVE_REG(10, r11) SAVE_REG(11, r12) SAVE_REG(12, r13) SAVE_REG(13, r14)
+    SAVE_REG(14, r15)
+    "ret\n"
+
+    "new_switch:\n"
+    PUSH_CALLEE_SAVED
+    FAKE_INTERRUPT("9f")
+    PUSH_REGS
+    "mov %rsp, %rdi\n"
+    "cld\n"
+    "call new_irq0\n"
+    POP_REGS
+    "iretq\n"
+    "9:\n"
+    POP_CALLEE_SAVED
+    "ret\n"
+
+    // irq0_pit -> toWaitloop(curProc)
+    "new_irq0:\n"
+    "sub $8, %rsp\n"
+    "lea proc_ksp(%rip), %rdi\n"
+    "mov sched_ksp(%rip), %rsi\n"
+    "call bench_switch_stacks\n"
+    "add $8, %rsp\n"
+    "ret\n"
+
+    // waitloop, always running the same process again
+    "sched_loop:\n"
+    "lea sched_ksp(%rip), %rdi\n"
+    "mov proc_ksp(%rip), %rsi\n"
+    "call bench_switch_stacks\n"
+    "jmp sched_loop\n"
+
+    // Same as switch_stacks in bootloader.asm
+    "bench_switch_stacks:\n"
+    PUSH_CALLEE_SAVED
+    "mov %rsp, (%rdi)\n"
+    "mov %rsi, %rsp\n"
+    POP_CALLEE_SAVED
+    "ret\n"
+);
+
+extern void sched_loop();
+
+int main() {
+    // waitloop's stack, made up so the first switch to it lands at the top of sched_loop
+    static uint64_t sched_stack[SCHED_STACK / 8] __attribute__((aligned(16)));
+    uint64_t* sp = &sched_stack[SCHED_STACK / 8];
+    *--sp = 0;
+    *--sp = (uint64_t) sched_loop;
+    for (int i = 0; i < 6; i++)
+        *--sp = 0;
+    sched_ksp = (uint64_t) sp;
+
+    printf("%-44s %8s\n", "", "cycles");
+
+    BENCH("preempt + resume, regs[] copies + 2 iretqs", old_switch());
+    BENCH("preempt + resume, kernel stack + 1 iretq", new_switch());
+    BENCH("switch_stacks there and back", bench_switch_stacks(&proc_ksp, sched_ksp));
+
+    return 0;
+}
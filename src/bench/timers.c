@@ -0,0 +1,72 @@
+#include "bench.h"
+
+// What a timer interrupt costs in deciding which callbacks are due, the old way and with timer.c's heap, for a handful of timers
+//   up to a few hundred.  Each tick is 1 ms of a simulated clock; periods are spread from 10 ms to a couple of seconds.  timer.c
+//   is built in as is (see the Makefile), with what it calls from the rest of the kernel stubbed out below.
+//
+// Old: every tick, a division for each callback to see whether ms crossed a multiple of its period.
+// New: every tick, a look at the earliest deadline, and a sift for each timer that's actually due.
+
+#define timerStart pos_timerStart
+#define timerStop pos_timerStop
+#define runTimers pos_runTimers
+
+#include "../kernel/timer.h"
+
+#define TICKS 200000
+#define MAX_TIMERS 512
+#define HEAP_SZ (1 << 20)
+
+uint64_t pos_int_blocks;
+void pos_rearmTimer() {}
+void pos_logf(char*, ...) {}
+
+static uint64_t period_ms[MAX_TIMERS];
+static struct timer timers[MAX_TIMERS];
+static uint64_t fired;
+
+static void fire(struct timer*) {
+    fired++;
+}
+
+int main() {
+    init_heap(host_region(HEAP_SZ), HEAP_SZ);
+
+    printf("%-10s %14s %14s %10s\n", "timers", "old cyc/tick", "heap cyc/tick", "fired/tick");
+
+    for (uint64_t n = 4; n <= MAX_TIMERS; n *= 4) {
+        srand(n);
+        for (uint64_t i = 0; i < n; i++)
+            period_ms[i] = 10 + rand() % 2000;
+
+        uint64_t checked = 0, old_fired = 0;
+        uint64_t start = cycles();
+        for (uint64_t ms = 1; ms <= TICKS; ms++) {
+            for (uint64_t i = 0; i < n; i++)
+                if (ms / period_ms[i] != checked / period_ms[i])
+                    old_fired++;
+            checked = ms;
+        }
+        uint64_t old_cycles = cycles() - start;
+
+        for (uint64_t i = 0; i < n; i++) {
+            timers[i].fire = fire;
+            timerStart(&timers[i], period_ms[i] * 1000000, period_ms[i] * 1000000);
+        }
+
+        fired = 0;
+        start = cycles();
+        for (uint64_t ms = 1; ms <= TICKS; ms++)
+            runTimers(ms * 1000000);
+        uint64_t heap_cycles = cycles() - start;
+
+        if (fired != old_fired)
+            printf("  (mismatch: old fired %lu, heap %lu)\n", old_fired, fired);
+
+        printf("%-10lu %14lu %14lu %10.3f\n", n, old_cycles / TICKS, heap_cycles / TICKS, (double) fired / TICKS);
+        for (uint64_t i = 0; i < n; i++)
+            timerStop(&timers[i]);
+    }
+
+    return 0;
+}
@@ -11,6 +11,12 @@ static uint8_t* apic = 0;
 static uint8_t* facp = 0;
 
 uint64_t* hpet_block = 0;
+uint16_t pm_timer_port = 0;
+uint8_t pm_timer_32bit = 0;
+
+#define FADT_PM_TMR_BLK 76
+#define FADT_FLAGS 112
+#define FADT_TMR_VAL_EXT (1 << 8)
 
 static uint8_t* find_rsdp() {
     uint64_t rsdp_sig = *((uint64_t*) "RSD PTR ");
@@ -84,4 +90,9 @@ void parse_acpi_tables() {
 
     if (hpet != 0)
         hpet_block = *(uint64_t**)(hpet + 44);
+
+    if (facp != 0) {
+        pm_timer_port = *(uint32_t*)(facp + FADT_PM_TMR_BLK);
+        pm_timer_32bit = !!(*(uint32_t*)(facp + FADT_FLAGS) & FADT_TMR_VAL_EXT);
+    }
 }
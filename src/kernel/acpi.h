@@ -3,5 +3,7 @@
 #include <stdint.h>
 
 extern uint64_t* hpet_block;
+extern uint16_t pm_timer_port; // ACPI PM timer, counting at 3.579545 MHz; 0 if none
+extern uint8_t pm_timer_32bit; // Otherwise it's 24 bits
 
 void parse_acpi_tables();
@@ -0,0 +1,260 @@
+#include <stdint.h>
+
+#include "alloc_profile.h"
+
+#ifdef ALLOC_PROFILE
+
+#include "boot_timeline.h"
+#include "interrupt.h"
+#include "log.h"
+#include "pages.h"
+
+#include "../lib/mem.h"
+
+// Both tables live in one 2 MB block straight from the frame allocator (so they're neither on the heap they describe nor counted
+//   as a palloc).  Live blocks are keyed by address with linear probing and backward-shift deletion, like the pid table; sites
+//   are keyed by return address and never removed.  Slot 0 of sites is a catch-all for when the site table fills up.
+
+#define PROFILE_ORDER 9
+#define LIVE_SHIFT 16
+#define LIVE_SLOTS (1ull << LIVE_SHIFT)
+#define LIVE_MASK (LIVE_SLOTS - 1)
+#define SITE_SHIFT 10
+#define SITE_SLOTS (1ull << SITE_SHIFT)
+#define SITE_MASK (SITE_SLOTS - 1)
+#define OTHER_SITE 0
+#define TOP_MAX 16
+#define EXIT_SHOWN 8
+
+#define hash(x, shift) (((uint64_t) (x) * 0x9E3779B97F4A7C15ull) >> (64 - (shift)))
+
+struct live {
+    uint64_t p; // 0 if slot is empty
+    uint64_t size;
+    uint32_t site;
+    uint32_t pid;
+};
+
+struct site {
+    uint64_t ret;
+    uint64_t live_bytes;
+    uint64_t live_objs;
+    uint64_t peak_bytes;
+    uint64_t allocs;
+    uint64_t allocs_at_report;
+};
+
+static struct live* live = 0;
+static struct site* sites;
+static uint64_t live_count, site_count, untracked;
+static uint64_t owner;
+static uint64_t report_tsc;
+
+void init_alloc_profile() {
+    uint8_t* mem = allocFrames(PROFILE_ORDER);
+    if (!mem)
+        return;
+
+    memset(mem, 0, LIVE_SLOTS * sizeof(struct live) + SITE_SLOTS * sizeof(struct site));
+    sites = (struct site*) (mem + LIVE_SLOTS * sizeof(struct live));
+    sites[OTHER_SITE].ret = 1;
+    site_count = 1;
+    report_tsc = read_tsc();
+
+    live = (struct live*) mem;
+}
+
+static uint32_t siteFor(uint64_t ret) {
+    uint64_t i = hash(ret, SITE_SHIFT);
+
+    for (;; i = (i + 1) & SITE_MASK) {
+        if (sites[i].ret == ret)
+            return i;
+
+        if (!sites[i].ret) {
+            if (site_count >= SITE_SLOTS * 3 / 4)
+                return OTHER_SITE;
+
+            sites[i].ret = ret;
+            site_count++;
+            return i;
+        }
+    }
+}
+
+static uint64_t find(uint64_t p) {
+    for (uint64_t i = hash(p, LIVE_SHIFT); live[i].p; i = (i + 1) & LIVE_MASK)
+        if (live[i].p == p)
+            return i;
+
+    return -1ull;
+}
+
+// Pulls back any later entry in the run that the hole would otherwise cut off from its home slot
+static void removeAt(uint64_t i) {
+    for (uint64_t j = (i + 1) & LIVE_MASK; live[j].p; j = (j + 1) & LIVE_MASK) {
+        uint64_t home = hash(live[j].p, LIVE_SHIFT);
+        if (((j - home) & LIVE_MASK) >= ((j - i) & LIVE_MASK)) {
+            live[i] = live[j];
+            i = j;
+        }
+    }
+
+    live[i].p = 0;
+    live_count--;
+}
+
+void profAlloc(void* p, uint64_t size, void* ret) {
+    if (!live || !p)
+        return;
+
+    no_ints();
+
+    if (live_count >= LIVE_SLOTS * 3 / 4) {
+        untracked++;
+        ints_okay();
+        return;
+    }
+
+    uint32_t s = siteFor((uint64_t) ret);
+    sites[s].allocs++;
+    sites[s].live_objs++;
+    sites[s].live_bytes += size;
+    if (sites[s].live_bytes > sites[s].peak_bytes)
+        sites[s].peak_bytes = sites[s].live_bytes;
+
+    uint64_t i = hash(p, LIVE_SHIFT);
+    while (live[i].p)
+        i = (i + 1) & LIVE_MASK;
+
+    live[i].p = (uint64_t) p;
+    live[i].size = size;
+    live[i].site = s;
+    live[i].pid = owner;
+    live_count++;
+
+    ints_okay();
+}
+
+void profFree(void* p) {
+    if (!live || !p)
+        return;
+
+    no_ints();
+
+    uint64_t i = find((uint64_t) p);
+    if (i != -1ull) {
+        sites[live[i].site].live_objs--;
+        sites[live[i].site].live_bytes -= live[i].size;
+        removeAt(i);
+    }
+
+    ints_okay();
+}
+
+// The block now belongs to the realloc's caller (failure leaves p as it was)
+void profRealloc(void* p, void* q, uint64_t size, void* ret) {
+    if (!q)
+        return;
+
+    profFree(p);
+    profAlloc(q, size, ret);
+}
+
+void profOwner(uint64_t pid) {
+    owner = pid;
+}
+
+void profChown(void* p, uint64_t pid) {
+    if (!live || !p)
+        return;
+
+    no_ints();
+
+    uint64_t i = find((uint64_t) p);
+    if (i != -1ull)
+        live[i].pid = pid;
+
+    ints_okay();
+}
+
+void profExit(uint64_t pid) {
+    if (!live || !pid)
+        return;
+
+    uint64_t objs = 0, bytes = 0;
+
+    no_ints();
+
+    for (uint64_t i = 0; i < LIVE_SLOTS; i++) {
+        if (!live[i].p || live[i].pid != pid)
+            continue;
+
+        if (objs < EXIT_SHOWN)
+            logl(LOG_WARN, "  pid %u left 0x%h: %u bytes from 0x%h\n", pid, live[i].p, live[i].size, sites[live[i].site].ret);
+
+        objs++;
+        bytes += live[i].size;
+        live[i].pid = 0;
+    }
+
+    ints_okay();
+
+    if (objs)
+        logl(LOG_WARN, "pid %u exited still owning %u bytes in %u allocations (now charged to the kernel)\n", pid, bytes, objs);
+}
+
+void reportAllocProfile(uint64_t top_n) {
+    if (!live)
+        return;
+
+    if (top_n > TOP_MAX)
+        top_n = TOP_MAX;
+
+    uint32_t top[TOP_MAX];
+    uint64_t n = 0, bytes = 0;
+
+    no_ints();
+
+    uint64_t now = read_tsc();
+    uint64_t elapsed = now - report_tsc;
+
+    // Top sites by live bytes, by insertion into a short sorted list
+    for (uint32_t s = 0; s < SITE_SLOTS; s++) {
+        if (!sites[s].ret)
+            continue;
+
+        bytes += sites[s].live_bytes;
+
+        if (n == top_n && (!n || sites[s].live_bytes <= sites[top[n - 1]].live_bytes))
+            continue;
+
+        uint64_t j = n < top_n ? n++ : n - 1;
+        for (; j > 0 && sites[top[j - 1]].live_bytes < sites[s].live_bytes; j--)
+            top[j] = top[j - 1];
+        top[j] = s;
+    }
+
+    logf("Allocation profile: %u bytes live in %u blocks from %u callsites (%u blocks untracked); top %u:\n",
+         bytes, live_count, site_count - 1, untracked, n);
+    logf("  live bytes  blocks    peak bytes    allocs  allocs/s  callsite\n");
+
+    for (uint64_t i = 0; i < n; i++) {
+        struct site* s = &sites[top[i]];
+        uint64_t rate = tsc_hz && elapsed ? (s->allocs - s->allocs_at_report) * tsc_hz / elapsed : 0;
+
+        if (s->ret == 1)
+            logf("  %p 10u  %p 6u  %p 12u  %p 8u  %p 8u  (other)\n", s->live_bytes, s->live_objs, s->peak_bytes, s->allocs, rate);
+        else
+            logf("  %p 10u  %p 6u  %p 12u  %p 8u  %p 8u  0x%h\n", s->live_bytes, s->live_objs, s->peak_bytes, s->allocs, rate,
+                 s->ret);
+    }
+
+    for (uint32_t s = 0; s < SITE_SLOTS; s++)
+        sites[s].allocs_at_report = sites[s].allocs;
+    report_tsc = now;
+
+    ints_okay();
+}
+
+#endif
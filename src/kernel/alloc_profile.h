@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// Allocation profiler, built only with `make ALLOC_PROFILE=1' (after a clean).  Otherwise every hook below is an empty macro, so
+//   malloc and palloc are exactly what they'd be without it.
+//
+// Each live malloc/realloc/palloc block is recorded with the return address it was allocated from, its size, and the pid it's
+//   charged to (whoever's syscall we were in, else 0 for the kernel).  Blocks roll up into per-callsite totals, and ctrl-alt-p
+//   logs the top callsites.  When a process exits, anything still charged to it is logged, then handed to the kernel.
+
+#ifdef ALLOC_PROFILE
+
+#define PROF_TOP 10 // Rows in the ctrl-alt-p report
+
+void init_alloc_profile();
+void profAlloc(void* p, uint64_t size, void* site);
+void profFree(void* p);
+void profRealloc(void* p, void* q, uint64_t size, void* site);
+void profOwner(uint64_t pid);
+void profChown(void* p, uint64_t pid);
+void profExit(uint64_t pid);
+void reportAllocProfile(uint64_t top_n);
+
+// In the allocator's public entry points, so the return address is the caller's
+#define PROF_ALLOC(p, size) profAlloc((p), (size), __builtin_return_address(0))
+#define PROF_FREE(p) profFree(p)
+#define PROF_REALLOC(p, q, size) profRealloc((p), (q), (size), __builtin_return_address(0))
+#define PROF_OWNER(pid) profOwner(pid)
+#define PROF_CHOWN(p, pid) profChown((p), (pid))
+#define PROF_EXIT(pid) profExit(pid)
+
+#else
+
+#define PROF_ALLOC(p, size)
+#define PROF_FREE(p)
+#define PROF_REALLOC(p, q, size)
+#define PROF_OWNER(pid)
+#define PROF_CHOWN(p, pid)
+#define PROF_EXIT(pid) (void) (pid)
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdint.h>
+
+#include "boot_timeline.h"
+
+#include "interrupt.h"
+#include "log.h"
+#include "periodic_callback.h"
+#include "rtc_int.h"
+
+#include "../lib/syscall.h"
+
+/*
+  TSC stamps for each stage of boot, from the first instruction of the MBR to the first shell waiting for input.  The bootloader
+    leaves its stamps at BOOTLOADER_STAMPS, and we copy them out first thing (that's down where the boot stack could eventually
+    grow into).  We don't know the TSC's rate until the PIT has been running a while, so the table gets printed (to the logs and
+    COM1) from a once-a-second callback, as soon as we've had a second to calibrate and a shell has prompted.
+*/
+
+#define BOOTLOADER_STAMPS ((uint64_t*) 0x4e00)
+#define BOOTLOADER_STAGES (BOOT_LONG_MODE + 1)
+#define CALIBRATION_MS 1000
+
+static char* names[BOOT_STAGES] = {
+    "mbr",
+    "disk loaded",
+    "e820",
+    "long mode",
+    "kernel entry",
+    "paging",
+    "pages",
+    "heap",
+    "interrupts",
+    "com1",
+    "first sh",
+    "tty",
+    "acpi",
+    "hpet",
+    "first prompt",
+};
+
+static uint64_t stamps[BOOT_STAGES];
+
+uint64_t tsc_hz = 0;
+
+void init_boot_timeline() {
+    for (int i = 0; i < BOOT_STAGES; i++)
+        stamps[i] = i < BOOTLOADER_STAGES ? BOOTLOADER_STAMPS[i] : 0;
+
+    bootStamp(BOOT_KERNEL_ENTRY);
+}
+
+// Only the first time counts, so it's fine to call from something that happens over and over
+void bootStamp(enum boot_stage s) {
+    if (!stamps[s])
+        stamps[s] = read_tsc();
+}
+
+static inline uint64_t us_at(int i) {
+    return (stamps[i] - stamps[BOOT_MBR]) * 1000000 / tsc_hz;
+}
+
+static void report() {
+    if ((!tsc_hz && ms_since_boot < CALIBRATION_MS) || !stamps[BOOT_FIRST_PROMPT])
+        return;
+
+    // The clock calibrates the TSC if there's an HPET or PM timer; if not, ms_since_boot is PIT ticks since init_interrupts
+    //   started the PIT
+    if (!tsc_hz)
+        tsc_hz = (read_tsc() - stamps[BOOT_INTERRUPTS]) * 1000 / ms_since_boot;
+    unregisterPeriodicCallback((struct periodic_callback) {1, 1, report, "boot report"});
+
+    // Each delta is from the last stage before it that was stamped (and 0 rather than wrapping, should one ever be out of order)
+    logf("Boot timeline (TSC at %u MHz):\n", tsc_hz / 1000000);
+    uint64_t prev = 0;
+    for (int i = 0; i < BOOT_STAGES; i++) {
+        if (!stamps[i]) {
+            logf("  %p 14s %p 10s\n", names[i], "-");
+            continue;
+        }
+
+        uint64_t at = us_at(i), delta = at > prev ? at - prev : 0;
+        if (at > prev)
+            prev = at;
+
+        logf("  %p 14s %p 10u us  (+%u)\n", names[i], at, delta);
+    }
+}
+
+uint64_t bootTsc() {
+    return stamps[BOOT_MBR];
+}
+
+void reportBootTimeline() {
+    registerPeriodicCallback((struct periodic_callback) {1, 1, report, "boot report"});
+}
+
+void getBootTimeline(struct sc_boot_timeline* t) {
+    t->tsc_hz = tsc_hz;
+    t->count = BOOT_STAGES;
+
+    for (int i = 0; i < BOOT_STAGES && i < SC_BOOT_STAGES; i++) {
+        t->us[i] = tsc_hz && stamps[i] ? us_at(i) : -1ull;
+
+        int j;
+        for (j = 0; names[i][j] && j < SC_BOOT_NAME_LEN - 1; j++)
+            t->names[i][j] = names[i][j];
+        t->names[i][j] = 0;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+struct sc_boot_timeline;
+
+// The first four are stamped by the bootloader; keep them in sync with BOOT_STAMP_* in bootloader.asm.  The rest are in the order
+//   they happen (the first sh is made by startTty, when it shows the first terminal, so it comes before tty's own stamp).
+enum boot_stage {
+    BOOT_MBR,
+    BOOT_DISK_LOADED,
+    BOOT_E820,
+    BOOT_LONG_MODE,
+    BOOT_KERNEL_ENTRY,
+    BOOT_PAGING,
+    BOOT_PAGES,
+    BOOT_HEAP,
+    BOOT_INTERRUPTS,
+    BOOT_COM1,
+    BOOT_FIRST_SH,
+    BOOT_TTY,
+    BOOT_ACPI,
+    BOOT_HPET,
+    BOOT_FIRST_PROMPT,
+    BOOT_STAGES
+};
+
+extern uint64_t tsc_hz;
+
+void init_boot_timeline();
+void bootStamp(enum boot_stage s);
+uint64_t bootTsc();
+void reportBootTimeline();
+void getBootTimeline(struct sc_boot_timeline* t);
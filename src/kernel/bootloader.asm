@@ -45,7 +45,7 @@
         page_table_l3 equ 0x2000
         page_table_l2 equ 0x3000
         int_15_mem_table equ 0x4000
-        page_tables_l2 equ 0x100000
+        boot_stamps equ 0x4e00  ; TSC at each stage of boot, for the kernel's boot timeline (see boot_timeline.c)
         stack_top equ 0x7bff
         idt equ 0               ; 0-0x1000 available in long mode
 
@@ -68,6 +68,12 @@
         SECT_PER_LOAD equ 120
         LOAD_COUNT equ 8
 
+        ; Indexes into boot_stamps; must match enum boot_stage in boot_timeline.h
+        BOOT_STAMP_MBR equ 0
+        BOOT_STAMP_DISK_LOADED equ 1
+        BOOT_STAMP_E820 equ 2
+        BOOT_STAMP_LONG_MODE equ 3
+
         INT_0x10_TELETYPE equ 0x0e
         INT_0x13_LBA_READ equ 0x42
 
@@ -84,6 +90,12 @@ start16:
 
         mov esp, stack_top
 
+        push dx                 ; BIOS gave us the drive number in dl
+        rdtsc
+        mov [boot_stamps + BOOT_STAMP_MBR * 8], eax
+        mov [boot_stamps + BOOT_STAMP_MBR * 8 + 4], edx
+        pop dx
+
         mov ax, 3
         int 0x10
 
@@ -115,6 +127,8 @@ lba_error:
         hlt
 
 lba_success:
+        mov bx, BOOT_STAMP_DISK_LOADED * 8
+        call stamp16
 
 mov dword [int_15_mem_table], 1
         mov ax, int_15_mem_table >> 4
@@ -141,6 +155,8 @@ smap_start:
         jmp smap_start
 
 smap_done:
+        mov bx, BOOT_STAMP_E820 * 8
+        call stamp16
 
         cli
 
@@ -226,32 +242,7 @@ start64:
         mov gs, ax
         mov ss, ax
 
-        mov rax, PT_PRESENT | PT_WRITABLE | PT_HUGE
-        mov rbx, page_tables_l2
-        mov rcx, 512 * 512
-l2s_loop:
-        mov [rbx], rax
-        add rax, SZ_2MB       ; Huge page bit makes for 2MB pages, so each page is this far apart
-        add rbx, SZ_QW
-        loop l2s_loop
-
-        mov rax, page_tables_l2 | PT_PRESENT | PT_WRITABLE | PT_USERMODE
-        mov rbx, page_table_l3
-        mov rcx, 512
-l3_loop2:
-        mov [rbx], rax
-        add rax, SZ_QW * 512
-        add rbx, SZ_QW
-        loop l3_loop2
-
-        ; Okay, we've identity-mapped 256 GB in lower half.  Now map upper half.
-
-        lidt [idtr]
-
-        mov ax, 32
-        ltr ax
-
-        jmp kernel_entry
+        jmp start64_rest        ; The boot sector is full; the rest is in what we loaded from disk
 
         BOOTABLE equ 1<<7
         times 440 - ($-$$) db 0
@@ -275,65 +266,123 @@ global tss
 tss:
         times 104 db 0
 
-global regs
-regs:
-.rax:   dq 0
-.rbx:   dq 0
-.rcx:   dq 0
-.rdx:   dq 0
-.rsi:   dq 0
-.rdi:   dq 0
-.rbp:   dq 0
-.r8:    dq 0
-.r9:    dq 0
-.r10:   dq 0
-.r11:   dq 0
-.r12:   dq 0
-.r13:   dq 0
-.r14:   dq 0
-.r15:   dq 0
-
-save_regs:
-        mov [regs.rax], rax
-        mov [regs.rbx], rbx
-        mov [regs.rcx], rcx
-        mov [regs.rdx], rdx
-        mov [regs.rsi], rsi
-        mov [regs.rdi], rdi
-        mov [regs.rbp], rbp
-        mov [regs.r8], r8
-        mov [regs.r9], r9
-        mov [regs.r10], r10
-        mov [regs.r11], r11
-        mov [regs.r12], r12
-        mov [regs.r13], r13
-        mov [regs.r14], r14
-        mov [regs.r15], r15
+        ; Stamping and the tail end of start64 live out here, past the boot sector, where there's room
+
+bits 16
+        ; bx is stamp index * 8
+stamp16:
+        push eax
+        push edx
+        rdtsc
+        mov [boot_stamps + bx], eax
+        mov [boot_stamps + bx + 4], edx
+        pop edx
+        pop eax
         ret
 
+bits 64
+start64_rest:
+        rdtsc
+        mov [boot_stamps + BOOT_STAMP_LONG_MODE * 8], eax
+        mov [boot_stamps + BOOT_STAMP_LONG_MODE * 8 + 4], edx
+
+        ; Only the first GB is identity-mapped at this point; the kernel builds the rest of the direct map from the e820 table.
+
+        lidt [idtr]
+
+        mov ax, 32
+        ltr ax
+
+        jmp kernel_entry
+
 extern irq0_pit
 extern int0x80_syscall
 extern waitloop
+extern kernel_stack_top
 
 global irq0
 global int0x80
-global iretqWaitloop
+global trap_return
+global switch_stacks
+global resetToWaitloop
+
+        ; Coming from a process, the CPU has switched to its kernel stack (tss.rsp0) and pushed ss, rsp, rflags, cs and rip; we
+        ;   push the rest so the whole thing is a struct trap_frame (see interrupt.c), which the handler gets a pointer to.
+%macro push_regs 0
+        push rax
+        push rbx
+        push rcx
+        push rdx
+        push rsi
+        push rdi
+        push rbp
+        push r8
+        push r9
+        push r10
+        push r11
+        push r12
+        push r13
+        push r14
+        push r15
+%endmacro
+
+%macro pop_regs 0
+        pop r15
+        pop r14
+        pop r13
+        pop r12
+        pop r11
+        pop r10
+        pop r9
+        pop r8
+        pop rbp
+        pop rdi
+        pop rsi
+        pop rdx
+        pop rcx
+        pop rbx
+        pop rax
+%endmacro
 
 irq0:
-        call save_regs
-        jmp irq0_pit
+        push_regs
+        mov rdi, rsp
+        cld
+        call irq0_pit
+        jmp trap_return
 
 int0x80:
-        call save_regs
-        jmp int0x80_syscall
-
-iretqWaitloop:
-        mov rax, rsp
-        push 0
-        push rax
-        pushf
-        push 8
-        push waitloop
+        push_regs
+        mov rdi, rsp
+        cld
+        call int0x80_syscall
+trap_return:                    ; Also where a new process's first switch_stacks returns to
+        pop_regs
         iretq
 
+        ; switch_stacks(uint64_t* save_sp, uint64_t sp): saves the callee-saved registers on the current stack and the stack
+        ;   pointer in *save_sp, then picks up on the other stack from wherever it called us (or from a new process's made-up
+        ;   frame).  The caller-saved ones are the compiler's business, so this is the whole switch.
+switch_stacks:
+        push rbx
+        push rbp
+        push r12
+        push r13
+        push r14
+        push r15
+        mov [rdi], rsp
+        mov rsp, rsi
+        pop r15
+        pop r14
+        pop r13
+        pop r12
+        pop rbp
+        pop rbx
+        ret
+
+        ; For boot and for recovering from a fault in the kernel: start waitloop over at the top of the kernel stack
+resetToWaitloop:
+        mov rsp, [kernel_stack_top]
+        jmp waitloop
+
 kernel_entry:
@@ -0,0 +1,201 @@
+#include <stdint.h>
+
+#include "clock.h"
+
+#include "acpi.h"
+#include "boot_timeline.h"
+#include "cpuid.h"
+#include "hpet.h"
+#include "interrupt.h"
+#include "io.h"
+#include "log.h"
+#include "paging.h"
+#include "rtc_int.h"
+
+#include "../lib/syscall.h"
+
+// Ratings are Linux's, more or less: the TSC is best (an instruction, no device access, so no VM exit either) as long as it's
+//   invariant, meaning it ticks at one rate whatever the CPU's doing; the HPET is next (a memory-mapped read); then the PM timer
+//   (a port read, and only 24 bits on some machines); the PIT's ticks are a last resort.
+//
+// The time is base_ns plus however far the counter's got past base_count.  clockTick moves the base up, with seq odd while it
+//   does, so a reader that a tick landed in the middle of just reads again.  (Only irq0 moves it, and nothing interrupts irq0,
+//   so a reader never actually sees seq odd; it's the change it looks for.)
+//
+// The same base goes in the kernel data page, under its own seq, for processes to read the time from.  They can only do that
+//   with the TSC (rdtsc works in user mode; the other counters need a port or the HPET's registers), so with anything else
+//   clock_mult there is 0 and they make the syscall.  A process can be interrupted mid-read, so there the retry does happen.
+
+#define CPUID_EXT_MAX 0x80000000
+#define CPUID_POWER 0x80000007
+#define CPUID_INVARIANT_TSC (1 << 8)
+
+#define PIT_HZ 1193182
+#define PM_TIMER_HZ 3579545
+#define CALIBRATION_HZ 50 // Calibrate the TSC over 1/50 s
+
+struct clocksource {
+    char* name;
+    uint64_t (*read)();
+    uint64_t hz;
+    uint64_t mask; // Counter wraps to 0 after this
+    uint64_t rating; // 0 if we don't have one
+};
+
+static uint64_t readPit() {
+    return pitClocks();
+}
+
+static uint64_t readTsc() {
+    return rdtsc();
+}
+
+static uint64_t readHpet() {
+    return hpetNow();
+}
+
+static uint64_t readPmTimer() {
+    return ind(pm_timer_port);
+}
+
+enum {PIT, TSC, HPET, PM_TIMER, SOURCES};
+
+static struct clocksource sources[SOURCES] = {
+    [PIT] = {"pit", readPit, PIT_HZ, -1ull, 110},
+    [TSC] = {"tsc", readTsc, 0, -1ull, 0},
+    [HPET] = {"hpet", readHpet, 0, -1ull, 0},
+    [PM_TIMER] = {"acpi_pm", readPmTimer, PM_TIMER_HZ, 0xffffff, 0},
+};
+
+static struct clocksource* cs = &sources[PIT];
+static uint64_t mult = (1000000000ull << 32) / PIT_HZ; // ns per count, << 32
+static uint64_t seq, base_ns, base_count;
+
+static inline uint64_t toNs(uint64_t counts) {
+    return ((unsigned __int128) counts * mult) >> 32;
+}
+
+uint64_t clockNs() {
+    uint64_t s, ns;
+
+    do {
+        s = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+        ns = base_ns + toNs((cs->read() - base_count) & cs->mask);
+    } while (s != __atomic_load_n(&seq, __ATOMIC_ACQUIRE));
+
+    return ns;
+}
+
+static uint64_t realtimeBase() {
+    return (epoch_at_boot * 1000 + 500) * 1000000; // The RTC only gives whole seconds, so guess we were halfway in
+}
+
+static void publish() {
+    __atomic_store_n(&kdata->seq, kdata->seq + 1, __ATOMIC_RELEASE);
+    kdata->clock_ns = base_ns;
+    kdata->clock_tsc = base_count;
+    kdata->clock_mult = cs == &sources[TSC] ? mult : 0;
+    kdata->realtime_ns = realtimeBase();
+    __atomic_store_n(&kdata->seq, kdata->seq + 1, __ATOMIC_RELEASE);
+}
+
+void clockTick() {
+    uint64_t now = cs->read();
+
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+    base_ns += toNs((now - base_count) & cs->mask);
+    base_count = now;
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+
+    publish();
+}
+
+uint64_t clockRealtimeNs() {
+    return realtimeBase() + clockNs();
+}
+
+char* clockName() {
+    return cs->name;
+}
+
+uint64_t clockGettime(uint64_t clock, struct sc_timespec* ts) {
+    uint64_t ns;
+
+    if (clock == SC_CLOCK_MONOTONIC)
+        ns = clockNs();
+    else if (clock == SC_CLOCK_REALTIME)
+        ns = clockRealtimeNs();
+    else
+        return -1ull;
+
+    ts->sec = ns / 1000000000;
+    ts->nsec = ns % 1000000000;
+
+    return 0;
+}
+
+// Counts the TSC over a stretch of the reference clock
+static uint64_t calibrateTsc(struct clocksource* ref) {
+    uint64_t want = ref->hz / CALIBRATION_HZ;
+    uint64_t r0 = ref->read(), t0 = rdtsc();
+    uint64_t r1, t1, counts;
+
+    do {
+        r1 = ref->read();
+        t1 = rdtsc();
+        counts = (r1 - r0) & ref->mask;
+    } while (counts < want);
+
+    return (t1 - t0) * ref->hz / counts; // 1/50 s of a 5 GHz TSC times a 100 MHz HPET is still only 10^16
+}
+
+// Interrupts must be off (which they are at boot)
+static void switchTo(struct clocksource* to) {
+    uint64_t now = clockNs();
+
+    cs = to;
+    mult = (1000000000ull << 32) / to->hz;
+    base_count = to->read();
+    base_ns = now;
+    publish();
+}
+
+void init_clock() {
+    no_ints();
+
+    if (hpet_hz) {
+        sources[HPET].hz = hpet_hz;
+        sources[HPET].mask = hpet_64bit ? -1ull : 0xffffffffull;
+        sources[HPET].rating = 250;
+    }
+
+    if (pm_timer_port) {
+        sources[PM_TIMER].mask = pm_timer_32bit ? 0xffffffffull : 0xffffff;
+        sources[PM_TIMER].rating = 200;
+    }
+
+    struct clocksource* ref = sources[HPET].rating ? &sources[HPET] : sources[PM_TIMER].rating ? &sources[PM_TIMER] : 0;
+    if (ref) {
+        sources[TSC].hz = calibrateTsc(ref);
+        tsc_hz = sources[TSC].hz;
+
+        uint8_t invariant = cpuid(CPUID_EXT_MAX).eax >= CPUID_POWER && cpuid(CPUID_POWER).edx & CPUID_INVARIANT_TSC;
+        sources[TSC].rating = invariant ? 300 : 100; // A TSC that may change speed is worse than any real clock
+
+        logf("TSC calibrated against %s at %u kHz (%sinvariant)\n", ref->name, tsc_hz / 1000, invariant ? "" : "not ");
+    }
+
+    struct clocksource* best = cs;
+    for (int i = 0; i < SOURCES; i++) {
+        if (sources[i].rating)
+            logf("Clocksource %s: %u Hz, rating %u\n", sources[i].name, sources[i].hz, sources[i].rating);
+        if (sources[i].rating > best->rating)
+            best = &sources[i];
+    }
+
+    if (best != cs)
+        switchTo(best);
+    logf("Using clocksource %s\n", cs->name);
+
+    ints_okay();
+}
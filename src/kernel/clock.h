@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+struct sc_timespec;
+
+// Monotonic nanoseconds since the PIT started, read from the best counter we have.  At boot (and on machines with nothing
+//   better) that's the PIT's ticks, so 1 ms resolution; init_clock rates the TSC, HPET and ACPI PM timer, calibrates the TSC
+//   against whichever of the others is there, and switches to the best.  Cheap enough to call from interrupt handlers.
+
+void init_clock();
+uint64_t clockNs();
+uint64_t clockRealtimeNs(); // Since the Unix epoch, going by the RTC at boot
+void clockTick(); // From irq0, so a counter that wraps is never left long enough to wrap twice
+char* clockName();
+uint64_t clockGettime(uint64_t clock, struct sc_timespec* ts); // 0, or -1 for an unknown clock
@@ -3,13 +3,16 @@
 
 #include "console.h"
 
+#include "alloc_profile.h"
 #include "interrupt.h"
 #include "io.h"
 #include "keyboard.h"
 #include "periodic_callback.h"
 #include "rtc.h"
 
+#include "../lib/arena.h"
 #include "../lib/malloc.h"
+#include "../lib/mem.h"
 #include "../lib/strings.h"
 
 #define VRAM ((uint8_t*) 0xb8000)
@@ -58,6 +61,40 @@ static struct vterm terms[TERM_COUNT];
 #define byte_at(t, i) page_for(t, i)[(i) % (LINES * 160)]
 #define word_at(t, i) (((uint16_t*) page_for(t, i))[(i) % (LINES * 160) / 2])
 #define qword_at(t, i) (((uint64_t*) page_for(t, i))[(i) % (LINES * 160) / 8])
+#define PAGE_BYTES (LINES * 160)
+#define BLANK 0x0700
+
+static inline uint64_t min(uint64_t a, uint64_t b) {
+    return a < b ? a : b;
+}
+
+// Moves n bytes of t's buffer from index src to index dst (which may overlap), a run that's contiguous in both pages at a time;
+//   front to back when moving down and back to front when moving up, so we never read something we've already overwritten.
+static void moveCells(uint64_t t, uint64_t dst, uint64_t src, uint64_t n) {
+    if (dst < src) {
+        while (n) {
+            uint64_t k = min(n, min(PAGE_BYTES - src % PAGE_BYTES, PAGE_BYTES - dst % PAGE_BYTES));
+            memmove(&byte_at(t, dst), &byte_at(t, src), k);
+            dst += k;
+            src += k;
+            n -= k;
+        }
+    } else {
+        while (n) {
+            uint64_t k = min(n, min((src + n - 1) % PAGE_BYTES + 1, (dst + n - 1) % PAGE_BYTES + 1));
+            memmove(&byte_at(t, dst + n - k), &byte_at(t, src + n - k), k);
+            n -= k;
+        }
+    }
+}
+
+static void blankCells(uint64_t t, uint64_t from, uint64_t to) {
+    while (from < to) {
+        uint64_t k = min(to - from, PAGE_BYTES - from % PAGE_BYTES);
+        memset16(&byte_at(t, from), BLANK, k / 2);
+        from += k;
+    }
+}
 
 static void addPage(uint64_t t, uint64_t i) {
     if (terms[t].buf[i])
@@ -66,11 +103,12 @@ static void addPage(uint64_t t, uint64_t i) {
     if (terms[t].cap < i + 2) {
         terms[t].cap *= 2;
         terms[t].buf = reallocz(terms[t].buf, terms[t].cap * sizeof(uint8_t*));
+        PROF_CHOWN(terms[t].buf, 0);
     }
 
-    terms[t].buf[i] = malloc(LINES * 160);
-    for (int j = 0; j < LINES * 20; j++)
-        ((uint64_t*) terms[t].buf[i])[j] = 0x0700070007000700ull;
+    terms[t].buf[i] = malloc(PAGE_BYTES);
+    memset16(terms[t].buf[i], BLANK, PAGE_BYTES / 2);
+    PROF_CHOWN(terms[t].buf[i], 0); // Scrollback belongs to the terminal, even when it's a process's printing that grew it
 }
 
 static inline void ensurePages(uint64_t t) {
@@ -139,8 +177,10 @@ static void writeStatusBar(char* s, uint8_t loc) {
     ints_okay();
 }
 
+#define HEAP_USE_LEN 24 // Keep in sync with the width in the right-aligning format below
+
 void updateHeapUse() {
-    char* s;
+    char s[HEAP_USE_LEN + 1], t[HEAP_USE_LEN + 1];
     uint64_t m = heapUsed();
     char* unit = "bytes";
 
@@ -149,22 +189,10 @@ void updateHeapUse() {
         m /= 1024;
     }
 
-    s = M_sprintf("Heap used: %u %s", m, unit);  // TODO: Round rather than floor and/or decimal point, etc.?
+    sprintf(s, sizeof(s), "Heap used: %u %s", m, unit);  // TODO: Round rather than floor and/or decimal point, etc.?
+    sprintf(t, sizeof(t), "%p 24s", s);
 
-    const uint64_t max_len = 24;
-    if (strlen(s) > max_len)
-        s[max_len] = 0;
-
-    if (strlen(s) < max_len) {
-        char* f = M_sprintf("%%p %us", max_len);
-        char* t = M_sprintf(f, s);
-        free(f);
-        free(s);
-        s = t;
-    }
-
-    writeStatusBar(s, 80 - strlen(s));
-    free(s);
+    writeStatusBar(t, 80 - strlen(t));
 }
 
 void updateClock() {
@@ -174,28 +202,30 @@ void updateClock() {
     char* ampm = t.hours >= 12 ? "PM" : "AM";
     uint8_t hours = t.hours % 12;
     if (hours == 0) hours = 12;
-    char *s = M_sprintf("%p 2u:%p02u:%p02u.%p03u %s", hours, t.minutes, t.seconds, t.ms, ampm);
+    char s[24];
+    sprintf(s, sizeof(s), "%p 2u:%p02u:%p02u.%p03u %s", hours, t.minutes, t.seconds, t.ms, ampm);
 
     writeStatusBar(s, 0);
-
-    free(s);
 }
 
 static void setStatusBar() {
-    for (uint64_t* v = (uint64_t*) STATUS_LINE; v < (uint64_t*) VRAM_END; v++)
-        *v = 0x5f005f005f005f00ull;
+    memset16(STATUS_LINE, 0x5f00, (VRAM_END - STATUS_LINE) / 2);
 
     writeStatusBar("PurpOS", 37);
 
     updateHeapUse(); // Clock will update very soon, but heap use won't for 2 seconds
 
-    registerPeriodicCallback((struct periodic_callback) {60, 1, updateClock});
-    registerPeriodicCallback((struct periodic_callback) {2, 1, updateHeapUse});
+    registerPeriodicCallback((struct periodic_callback) {60, 1, updateClock, "console clock"});
+    registerPeriodicCallback((struct periodic_callback) {2, 1, updateHeapUse, "heap use"});
 }
 
 static void syncScreen() {
-    for (uint64_t i = 0; i < LINES * 20; i++)
-        VRAM64[i] = qword_at(at, top(at) + i * 8);
+    // The screen's worth of buffer starting at top spans at most two pages
+    uint64_t tp = top(at);
+    uint64_t first = PAGE_BYTES - tp % PAGE_BYTES;
+    memcpy(VRAM, &byte_at(at, tp), first);
+    if (first < PAGE_BYTES)
+        memcpy(VRAM + first, &byte_at(at, tp + first), PAGE_BYTES - first);
 
     updateCursorPosition();
 }
@@ -272,8 +302,7 @@ static inline void ensureTerm(uint64_t t) {
 
 static inline void printcc(uint64_t t, uint8_t c, uint8_t cl) {
     if (terms[t].cur < terms[t].end)
-        for (uint64_t i = terms[t].end; i > terms[t].cur; i -= 2)
-            word_at(t, i) = word_at(t, i - 2);
+        moveCells(t, terms[t].cur + 2, terms[t].cur, terms[t].end - terms[t].cur);
 
     word_at(t, terms[t].cur) = (cl << 8) | c;
 
@@ -287,10 +316,8 @@ static inline void backspace() {
     if (terms[at].cur == terms[at].anchor)
         return;
 
-    for (uint64_t i = terms[at].cur; i < terms[at].end; i += 2)
-        word_at(at, i - 2) = word_at(at, i);
-
-    word_at(at, terms[at].end - 2) = 0x0700;
+    moveCells(at, terms[at].cur - 2, terms[at].cur, terms[at].end - terms[at].cur);
+    word_at(at, terms[at].end - 2) = BLANK;
 
     terms[at].cur -= 2;
     terms[at].end -= 2;
@@ -304,10 +331,8 @@ static inline void delete() {
     if (terms[at].cur == terms[at].end)
         return;
 
-    for (uint64_t i = terms[at].cur; i + 2 < terms[at].end; i += 2)
-        word_at(at, i) = word_at(at, i + 2);
-
-    word_at(at, terms[at].end - 2) = 0x0700;
+    moveCells(at, terms[at].cur, terms[at].cur + 2, terms[at].end - terms[at].cur - 2);
+    word_at(at, terms[at].end - 2) = BLANK;
 
     terms[at].end -= 2;
 
@@ -342,10 +367,8 @@ static inline void deleteWordLeft() {
         terms[at].cur -= 2;
 
     uint64_t cur_diff = old_cur - terms[at].cur;
-    for (uint64_t i = 0; old_cur + i < terms[at].end; i += 2)
-        word_at(at, terms[at].cur + i) = word_at(at, old_cur + i);
-    for (uint64_t i = 0; i < cur_diff; i += 2)
-        word_at(at, terms[at].end - cur_diff + i) = 0x0700;
+    moveCells(at, terms[at].cur, old_cur, terms[at].end - old_cur);
+    blankCells(at, terms[at].end - cur_diff, terms[at].end);
 
     terms[at].end -= cur_diff;
 
@@ -367,11 +390,8 @@ static inline void deleteWordRight() {
 
     //uint64_t diff = c - terms[at].cur;
 
-    uint64_t i = 0;
-    for (; c + i < terms[at].end; i += 2)
-        word_at(at, terms[at].cur + i) = word_at(at, c + i);
-    for (; terms[at].cur + i < terms[at].end; i += 2)
-        word_at(at, terms[at].cur + i) = 0x0700;
+    moveCells(at, terms[at].cur, c, terms[at].end - c);
+    blankCells(at, terms[at].end - (c - terms[at].cur), terms[at].end);
 
     terms[at].end -= c - terms[at].cur;
 
@@ -463,13 +483,24 @@ void setReading(uint64_t t, uint64_t pid) {
     terms[t].reading = pid;
 }
 
-char* M_readline() {
-    uint64_t len = terms[at].end - terms[at].anchor + 1;
-    char* s = malloc(len);
-    s[len - 1] = 0;
+// Who a finished line would go to: whoever's reading on the terminal that's getting the keys (0 if no one)
+uint64_t lineReader() {
+    return terms[at].reading;
+}
+
+// Scratch space for handling a keypress.  gotInput resets it when done, and the arena keeps its chunk as a spare, so only the
+//   first line (or one longer than any before it) touches the heap.
+static struct arena scratch;
+
+static char* readLine(struct arena* a) {
+    uint64_t len = (terms[at].end - terms[at].anchor) / 2;
+    char* s = arenaAlloc(a, len + 1);
+    if (!s)
+        return 0;
 
     for (uint64_t i = 0; i < len; i++)
         s[i] = byte_at(at, terms[at].anchor + i * 2);
+    s[len] = 0;
 
     return s;
 }
@@ -481,11 +512,8 @@ static inline void clearCurToAnchor() {
         return;
 
     uint64_t cur_diff = terms[at].cur - terms[at].anchor;
-    uint64_t i;
-    for (i = 0; terms[at].cur + i < terms[at].end; i += 2)
-        word_at(at, terms[at].anchor + i) = word_at(at, terms[at].cur + i);
-    for (; terms[at].anchor + i < terms[at].end; i += 2)
-        word_at(at, terms[at].anchor + i) = 0x0700;
+    moveCells(at, terms[at].anchor, terms[at].cur, terms[at].end - terms[at].cur);
+    blankCells(at, terms[at].end - cur_diff, terms[at].end);
 
     terms[at].cur -= cur_diff;
     terms[at].end -= cur_diff;
@@ -499,8 +527,7 @@ static inline void clearCurToEnd() {
     if (terms[at].cur == terms[at].end)
         return;
 
-    for (uint64_t i = terms[at].cur; i < terms[at].end; i += 2)
-        word_at(at, i) = 0x0700;
+    blankCells(at, terms[at].cur, terms[at].end);
 
     terms[at].end = terms[at].cur;
 
@@ -564,9 +591,11 @@ void printf(char* fmt, ...) {
 }
 
 void vaprintf(uint64_t t, char* fmt, va_list* ap) {
-    char* s = M_vsprintf(0, 0, fmt, *ap);
+    char buf[VARIADIC_PRINT_BUF];
+    char* s = M_vsprintfBuf(buf, VARIADIC_PRINT_BUF, fmt, *ap);
     printTo(t, s);
-    free(s);
+    if (s != buf)
+        free(s);
 }
 
 static void showTerm(uint64_t t) {
@@ -640,6 +669,11 @@ static void gotInput(struct input i) {
     else if (i.key == KEY_LEFT && !i.alt && i.ctrl && !i.shift)
         showTerm((at + 9) % 10);
 
+#ifdef ALLOC_PROFILE
+    else if (i.key == 'p' && i.alt && i.ctrl && !i.shift)
+        reportAllocProfile(PROF_TOP);
+#endif
+
     else if (at > 0) {
         if (isPrintable(i.key) && !i.alt && !i.ctrl) {
             scrollToBottom();
@@ -657,17 +691,18 @@ static void gotInput(struct input i) {
             deleteWordRight();
 
         else if (i.key == '\n' && !i.alt && !i.ctrl && !i.shift) {
-            char* l = M_readline();
+            struct arena_mark m = arenaMark(&scratch);
+            char* l = readLine(&scratch);
 
             terms[at].cur = terms[at].end;
             print("\n");
 
-            if (terms[at].reading) {
+            if (terms[at].reading && l) {
                 gotLine(terms[at].reading, l);
                 terms[at].reading = 0;
             }
 
-            free(l);
+            arenaReset(&scratch, m);
         }
 
         else if (i.key == 'u' && !i.alt && i.ctrl && !i.shift)
@@ -15,3 +15,4 @@ void startTty();
 void vaprintf(uint64_t t, char* fmt, va_list* ap);
 void procDone(uint64_t pid, uint64_t t);
 void setReading(uint64_t t, uint64_t pid);
+uint64_t lineReader();
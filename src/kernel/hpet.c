@@ -7,6 +7,27 @@
 
 #include "../lib/malloc.h"
 
+#define GCAP 0
+#define GCR 2
+#define COUNTER 30
+#define T0_CONFIG 32
+#define T0_COMPARATOR 33
+
+#define GCAP_COUNT_SIZE (1 << 13) // 64-bit main counter
+#define GCAP_LEG_RT (1 << 15)
+#define GCR_ENABLE 1
+#define GCR_LEG_RT (1 << 1)       // Timer 0 drives IRQ 0 (and timer 1 IRQ 8) in place of the PIT (and RTC)
+#define TN_INT_LEVEL (1 << 1)
+#define TN_INT_ENABLE (1 << 2)
+#define TN_PERIODIC (1 << 3)
+#define TN_SIZE (1 << 5)          // 64-bit comparator
+#define TN_32MODE (1 << 8)
+
+#define reg(r) (((volatile uint64_t*) hpet_block)[r])
+
+uint64_t hpet_hz = 0; // 0 if there's no HPET (or it doesn't say how fast it counts)
+uint8_t hpet_64bit = 0;
+
 /*
   000-007h RO General Capabilities and ID Register
   010-017h RW General Configuration Register
@@ -53,4 +74,51 @@ void init_hpet() {
 
     uint64_t mcvr = hpet_block[30];
     logf("Main Counter Value Register: 0x%p016h\n", mcvr);
+
+    if (!counter_clk_period)
+        return;
+
+    // Firmware needn't have started it; with no timer routed anywhere yet, this just gets the counter going for the clock
+    hpet_hz = 1000000000000000ull / counter_clk_period;
+    hpet_64bit = !!(gcir & GCAP_COUNT_SIZE);
+    reg(GCR) |= GCR_ENABLE;
+}
+
+// Takes IRQ 0 over from the PIT, with timer 0 as a one-shot: nothing fires until a deadline is set, and then just once.  Returns
+//   0 (leaving the PIT alone) if the HPET can't do it.
+int hpetStartOneShot() {
+    if (!hpet_hz || !hpet_64bit)
+        return 0;
+
+    uint64_t t0 = reg(T0_CONFIG);
+    if (!(reg(GCAP) & GCAP_LEG_RT) || !(t0 & TN_SIZE))
+        return 0;
+
+    reg(T0_CONFIG) = (t0 & ~(uint64_t) (TN_INT_LEVEL | TN_PERIODIC | TN_32MODE)) | TN_INT_ENABLE;
+    reg(T0_COMPARATOR) = -1ull;
+    reg(GCR) |= GCR_LEG_RT;
+
+    logf("HPET timer 0 is now IRQ 0, one-shot, at %u Hz\n", hpet_hz);
+
+    return 1;
+}
+
+uint64_t hpetNow() {
+    return reg(COUNTER);
+}
+
+// The comparator only fires on a match, so a deadline the counter has already passed would never fire (not until the counter
+//   wraps, anyway); if we were too late, try again a little further out.
+void hpetFireAt(uint64_t count) {
+    uint64_t margin = hpet_hz / 100000; // 10 us
+
+    for (;;) {
+        reg(T0_COMPARATOR) = count;
+
+        uint64_t now = reg(COUNTER);
+        if ((int64_t) (count - now) > 0)
+            return;
+
+        count = now + margin;
+    }
 }
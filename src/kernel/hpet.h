@@ -1,3 +1,11 @@
 #pragma once
 
+#include <stdint.h>
+
+extern uint64_t hpet_hz;
+extern uint8_t hpet_64bit;
+
 void init_hpet();
+int hpetStartOneShot();
+uint64_t hpetNow();
+void hpetFireAt(uint64_t count);
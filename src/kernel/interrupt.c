@@ -3,17 +3,27 @@
 
 #include "interrupt.h"
 
+#include "alloc_profile.h"
+#include "boot_timeline.h"
+#include "clock.h"
 #include "console.h"
+#include "hpet.h"
 #include "io.h"
 #include "keyboard.h"
 #include "log.h"
+#include "pages.h"
+#include "paging.h"
 #include "periodic_callback.h"
-#include "periodic_callback_int.h"
 #include "rtc_int.h"
+#include "timer.h"
+#include "work.h"
 
-#include "../lib/list.h"
+#include "../lib/ilist.h"
 #include "../lib/malloc.h"
+#include "../lib/mem.h"
+#include "../lib/pid_table.h"
 #include "../lib/strings.h"
+#include "../lib/syscall.h"
 
 // TODO: Keep thinking about what I want to do about sprinkling cli and sti all over the place.
 //   It's iffy turning interrupts back on sometimes -- maybe they still need to be off because of
@@ -81,81 +91,35 @@ struct interrupt_frame {
 };
 
 
-#define INIT_WQ_CAP 20
-#define INIT_KB_CAP 20
-
 uint64_t int_blocks = 0;
 
 uint64_t read_tsc() {
-    uint64_t tsc;
-
-    // edx gets high-order doubleword, eax gets low-order doubleword
+    uint32_t lo, hi;
 
+    // lfence so everything before us is done before we read the counter (cpuid would do too, but traps to the hypervisor under
+    //   virtualization); edx gets high-order doubleword, eax gets low-order doubleword
     __asm__ __volatile__(
-        "cpuid\n"
+        "lfence\n"
         "rdtsc\n"
-        "shl $32, %%rdx\n"
-        "add %%rdx, %%rax\n"
-        "mov %%rax, %0\n"
-        :"=m"(tsc)
+        :"=a"(lo), "=d"(hi)
     );
 
-    return tsc;
+    return (uint64_t) hi << 32 | lo;
 }
 
 static uint64_t pitCount = 0;
 
-struct queue {
-    void** start;
-    void** head;
-    void** tail;
-    uint64_t cap;
-};
-
-static struct queue wq = {};
-// It's quite space inefficient to have 8-byte wide slots for key codes, but I don't expect the buffer to
-//   ever get very full, and it's simplest to just have one queue type, I think?
-static struct queue kbd_buf = {};
-
-
-#define INITQ(q, c) q.start = q.head = q.tail = malloc(c * sizeof(void*)); \
-    q.cap = c
-
-#define INC_Q_PT(q, p) (q->p)++; if ((q->p) == q->start + q->cap) (q->p) = q->start;
-
-static inline void* pop(struct queue* q) {
-    __asm__ __volatile__("cli"); // I think I want to special case this and not use no_ints() and ints_okay()?
-
-    if (q->head == q->tail) return 0;
-
-    void* p = *(q->head);
-    INC_Q_PT(q, head);
-
-    __asm__ __volatile__("sti");
-
-    return p;
+// The PIT's input clock, as counted a tick's worth at a time; the clock's last resort
+uint64_t pitClocks() {
+    return pitCount * PIT_COUNT;
 }
 
-// To be called only when interrupts are off (From handler or during initialization);
-static inline void push(struct queue* q, void* p) {
-    if (q->tail + 1 == q->head || (q->tail + 1 == q->start + q->cap && q->head == q->start)) {
-        q->cap *= 2;
-        uint64_t head_off = q->head - q->start;
-        uint64_t tail_off = q->tail - q->start;
-        q->start = realloc(q->start, q->cap * sizeof(void*));
-
-        q->head = q->start + head_off;
-        q->tail = q->start + tail_off;
-    }
-
-    *(q->tail) = p;
-    INC_Q_PT(q, tail);
+static void keyWork(uint64_t code) {
+    keyScanned(code);
 }
 
-#define PT_PRESENT  1
-#define PT_WRITABLE 1 << 1
-#define PT_USERMODE 1 << 2
-#define PT_HUGE     1 << 7
+// Each scancode goes in the high lane with it, and in the order they came
+static struct work key_work = {.name = "keyboard", .fn = keyWork, .lane = WORK_HIGH};
 
 // 4=REX
 //  9 = 0b1001 WRXB
@@ -172,112 +136,292 @@ static inline void push(struct queue* q, void* p) {
 // 49 ff c7   inc r15
 // eb fb      jmp -5      eb = jmp, fb = -5
 
-struct process {
-    uint64_t rax;
-    uint64_t rbx;
-    uint64_t rcx;
-    uint64_t rdx;
-    uint64_t rsi;
-    uint64_t rdi;
-    uint64_t rbp;
-    uint64_t r8;
-    uint64_t r9;
-    uint64_t r10;
-    uint64_t r11;
-    uint64_t r12;
-    uint64_t r13;
-    uint64_t r14;
+// What irq0 and int0x80 (bootloader.asm) leave on the kernel stack: the registers they push, then what the CPU pushed.  Coming
+//   from user mode, the CPU always starts at tss.rsp0, so a process's user registers are always at the very top of its kernel stack.
+struct trap_frame {
     uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t r11;
+    uint64_t r10;
+    uint64_t r9;
+    uint64_t r8;
+    uint64_t rbp;
+    uint64_t rdi;
+    uint64_t rsi;
+    uint64_t rdx;
+    uint64_t rcx;
+    uint64_t rbx;
+    uint64_t rax;
 
     uint64_t rip;
-    uint64_t rsp;
+    uint64_t cs;
     uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+};
+
+#define KSTACK_ORDER 2 // 16 KB worth of 4 KB frames
+#define KSTACK_SIZE (4096 << KSTACK_ORDER)
+#define USER_CS 0x13
+#define USER_SS 0x1b
+#define RFLAGS_IF 0x200
+
+struct process {
+    uint64_t ksp; // Saved kernel stack pointer while it isn't running (switch_stacks' frame is on top)
+    void* kstack;
 
     uint64_t stdout;
     uint64_t pid;
 
     void* page; // For now only one page allowed
-    void* node;
+    struct ilist_node run_node; // On runQueues[level] when runnable (and not running)
+    struct ilist_node sibling_node; // On parent's children, or rootProcs if no parent
 
     struct process* waiting; // For now just one process can wait for a given process to exit
 
     struct process* parent;
-    struct list* children;
+    struct ilist children;
+
+    uint8_t nice;  // Level it starts at and goes back to whenever it wakes; it's never run above it
+    uint8_t level; // Run queue it's on, or goes back on when preempted (0 runs first)
+
+    uint64_t cpu_ns;    // Time spent running, its syscalls included
+    uint64_t slices;    // Times it's been switched to
+    uint64_t preempted; // Times it used up a whole slice
+    uint64_t woke_ns;   // When whatever woke it happened, until it runs (0 otherwise)
+    uint64_t slice_left_ns; // What was left of its slice when it was switched out for a wakeup (0 for a fresh one)
+
+    struct timer sleep_timer; // Armed while it's sleeping
 };
 
 // Huh, what if I didn't keep a list of waiting/sleeping procs?  Terminal has a reference, and can send termination signal, or readline, etc.
 // Presumably it will be natural for other sleep reasons (like sleeping for a given time, or reading from disk or network, if those are ever
 //   things here) for them to also have a reference to their relevant process, or else I'd have a list special to whatever it was.
-// So maybe runnableProcs is only list here?
+// So maybe the run queues are the only lists here?
 // We'll want to make sure in that case to not assume every process has a node...
 // I mean, ultimately, it feels pretty wrong to not be able to say, here, here's all the processes.
 // Hmm, at some point, maybe soon, perhaps each process will have a list of subprocesses?  So you can hold "init" process, and walk the
 //   tree to all other processes?
 // Might I ever want to kill a whole tree?
 
-static struct list* runnableProcs = (struct list*) 0;
-static struct list* rootProcs = (struct list*) 0;
+// One run queue per priority level, with a bit in runLevels for each one that's non-empty, so picking who runs next is a
+//   find-first-set and a pop however many processes there are.  Levels 0 to BATCH_LEVEL - 1 are the interactive class and the rest
+//   are batch, which gets longer slices, as it's throughput it wants rather than a quick turn.  A process that uses up a whole
+//   slice drops a level (so anything CPU-bound sinks into batch on its own), and one that blocks goes back to its nice level when
+//   it wakes (so the shell, always waiting on a line, stays on top).  Within a level it's round robin.
+#define PRIO_LEVELS SC_PRIO_LEVELS
+#define BATCH_LEVEL SC_BATCH_LEVEL
+#define INTERACTIVE_SLICE_MS 2
+#define BATCH_SLICE_MS 10
+
+#define sliceMs(level) ((level) < BATCH_LEVEL ? INTERACTIVE_SLICE_MS : BATCH_SLICE_MS)
+
+static struct ilist runQueues[PRIO_LEVELS];
+static uint64_t runLevels;
+static struct ilist rootProcs;
 
 static struct process* curProc = 0;
 
-#define PIDS_SZ 1000
-static struct list* pids[PIDS_SZ];
-static uint64_t last_pid = 0;
+// Set when something should run ahead of curProc (or may be about to, as with a keypress waitloop hasn't got to yet), so it's
+//   switched out on the way back from the interrupt or syscall, rather than making the woken process wait out the slice.
+static uint8_t resched;
 
-struct pidMap {
-    uint64_t pid;
-    struct process* p;
-};
+// Wakeup latency, from whatever woke a process (the keypress, for a readline) to it running, in power-of-two buckets of us.  The
+//   counts here and below are kept in the kernel data page, so processes can read them without a syscall.
+static uint64_t wake_hist[SC_WAKE_BUCKETS];
+
+#define PID_MAX (1 << 22)
+static struct pid_table* pids;
 
 static struct process* procByPid(uint64_t pid) {
-    struct pidMap* pm = listItem(getNodeByCondition(pids[pid % PIDS_SZ], ({
-        int __fn__ (void* item) {
-            return ((struct pidMap*) item)->pid == pid;
-        }
+    return pidTableGet(pids, pid);
+}
+
+static void makeRunnable(struct process* p) {
+    if (p->run_node.list)
+        return;
+
+    pushIListTail(&runQueues[p->level], &p->run_node);
+    runLevels |= 1ull << p->level;
+}
+
+static void unqueue(struct process* p) {
+    struct ilist* q = p->run_node.list;
+    if (!q)
+        return;
+
+    removeFromIList(&p->run_node);
+    if (!q->len)
+        runLevels &= ~(1ull << (q - runQueues));
+}
+
+// Off its run queue; it's put back when preempted or woken
+static struct process* nextToRun() {
+    if (!runLevels)
+        return 0;
+
+    uint64_t level = __builtin_ctzll(runLevels);
+    struct process* p = iListItem(popIListHead(&runQueues[level]), struct process, run_node);
+    if (!runQueues[level].len)
+        runLevels &= ~(1ull << level);
+
+    return p;
+}
+
+// since is when the event it was waiting on happened, for its wakeup latency
+static void wake(struct process* p, uint64_t since) {
+    if (p->run_node.list)
+        return;
+
+    p->level = p->nice;
+    p->woke_ns = since;
+    makeRunnable(p);
+
+    if (curProc && p->level < curProc->level)
+        resched = 1;
+}
+
+// From irq0, when a sleeping process's time is up; its latency counts from when it was due
+static void wakeSleeper(struct timer* t) {
+    wake((struct process*) ((uint8_t*) t - __builtin_offsetof(struct process, sleep_timer)), t->due_ns);
+}
+
+static void recordWakeup(uint64_t ns) {
+    kdata->wakeups++;
+
+    uint64_t us = ns / 1000;
+    uint64_t b = us ? 64 - __builtin_clzll(us) : 0;
+    wake_hist[b < SC_WAKE_BUCKETS ? b : SC_WAKE_BUCKETS - 1]++;
+}
+
+#define trapFrame(p) ((struct trap_frame*) ((uint8_t*) (p)->kstack + KSTACK_SIZE) - 1)
+
+extern uint8_t tss;
+#define tss_rsp0 (*(uint64_t*) (&tss + 4))
+
+void switch_stacks(uint64_t* save_sp, uint64_t sp);
+void trap_return();
+
+static uint64_t sched_ksp; // waitloop's stack pointer while a process is running
+static uint64_t run_ns;    // When curProc was switched to
+static uint64_t slice_end; // Clock ns at which curProc is preempted, if it's in user mode
+static void* dead_kstack; // Kernel stack of a process that exited while on it, for waitloop to free once it's off it
+
+// With the HPET, IRQ 0 is a one-shot set for whatever's due next (the earliest timer, or the end of the running process's slice),
+//   so an idle machine wakes when there's something to do rather than 1000 times a second, and a busy one isn't interrupted
+//   mid-slice for nothing.  Without one (or built with `make PERIODIC_TICK=1', to compare), it's the PIT ticking at TICK_HZ, and
+//   timers and slices are only as good as the tick.  Either way they're timed by the clock, read on each timer interrupt.
+#define IDLE_MAX_NS 1000000000ull // Furthest out we set the timer, even with nothing due
+
+static uint8_t tickless;
+static uint64_t timer_ns; // Clock ns the timer's set to go off at, when tickless
+
+// The clock may not be the HPET, so this goes by how far off ns is now, rather than by any fixed relation between the two
+static void setTimer(uint64_t ns) {
+    uint64_t now = clockNs(), at = hpetNow();
+
+    timer_ns = ns;
+    hpetFireAt(ns > now ? at + ((ns - now) * hpet_hz + 999999999) / 1000000000 : at); // Rounded up, so it's not a hair early
+}
+
+// Earliest of the next timer and the running process's slice ending
+static uint64_t nextDeadline(uint64_t now) {
+    uint64_t next = now + IDLE_MAX_NS;
+
+    if (timerNext() < next)
+        next = timerNext();
+
+    if (curProc && slice_end > now && slice_end < next)
+        next = slice_end;
+
+    return next;
+}
+
+// For when something may be due sooner than the timer's set for (a timer was just started, say)
+void rearmTimer() {
+    if (!tickless)
+        return;
+
+    no_ints();
+    uint64_t next = nextDeadline(clockNs());
+    if (next < timer_ns)
+        setTimer(next);
+    ints_okay();
+}
+
+void init_tickless() {
+    no_ints();
 
-        __fn__;
-    })));
+    if (hpetStartOneShot()) {
+        tickless = 1;
+        setTimer(nextDeadline(clockNs()));
+    } else {
+        log("No HPET one-shot timer; staying with the PIT's periodic tick\n");
+    }
+
+    ints_okay();
+}
+
+static inline int onKernelStackOf(struct process* p) {
+    uint8_t here;
+    return p && &here >= (uint8_t*) p->kstack && &here < (uint8_t*) p->kstack + KSTACK_SIZE;
+}
 
-    if (pm)
-        return pm->p;
+// Back to waitloop from a process's kernel stack (after putting it wherever it should wait); returns when waitloop runs it again
+static void toWaitloop(struct process* p) {
+    p->cpu_ns += clockNs() - run_ns;
+    switch_stacks(&p->ksp, sched_ksp);
+}
 
-    return 0;
+// For after killProc on the process's own stack
+static void __attribute__((noreturn)) leaveDeadProc() {
+    uint64_t unused;
+    switch_stacks(&unused, sched_ksp);
+    __builtin_unreachable();
 }
 
 void killProc(struct process* p) {
     if (!p)
         return;
 
-    free(p->page);
-    procDone(p->pid, p->stdout);
+    uint64_t pid = p->pid;
 
-    if (p->waiting)
-        p->waiting->node = pushListTail(runnableProcs, p->waiting);
+    if (onKernelStackOf(p))
+        dead_kstack = p->kstack;
+    else
+        freeFrames(p->kstack);
 
-    removeFromListWithEquality(pids[p->pid % PIDS_SZ], ({
-        int __fn__ (void* item) {
-            return ((struct pidMap*) item)->pid == p->pid;
-        }
+    pfree(p->page);
+    procDone(p->pid, p->stdout);
 
-        __fn__;
-    }));
+    if (p->waiting)
+        wake(p->waiting, clockNs());
 
-    free(p);
+    pidTableRemove(pids, p->pid);
+    removeFromIList(&p->sibling_node);
 
-    if (!curProc)
-        return;
+    // Orphans become roots rather than keeping a pointer to freed memory
+    struct ilist_node* c;
+    while ((c = popIListHead(&p->children))) {
+        iListItem(c, struct process, sibling_node)->parent = 0;
+        pushIListTail(&rootProcs, c);
+    }
 
-    if (p == curProc && nextNodeCirc(runnableProcs, curProc->node) == curProc->node)
+    if (p == curProc)
         curProc = 0;
 
-    removeFromList(runnableProcs, p);
+    unqueue(p);
+    timerStop(&p->sleep_timer);
 
+    free(p);
+    PROF_EXIT(pid);
 }
 
 // Caller should probably call no_ints before calling, and wait until after it's used the process's memory to call ints_okay, I think?
 void mapProcMem(struct process* p) {
-    uint64_t* l2 = (uint64_t*) (0x100000 + (511 * 4096));
-    l2[0] = (uint64_t) p->page | PT_PRESENT | PT_WRITABLE | PT_HUGE | PT_USERMODE;
+    proc_l2[0] = (uint64_t) p->page | PT_PRESENT | PT_WRITABLE | PT_HUGE | PT_USERMODE;
 
     asm volatile ("\
 \n      mov $0x7FC0000000, %rax                \
@@ -285,54 +429,27 @@ void mapProcMem(struct process* p) {
     ");
 }
 
-void startProc(struct process* p) {
-    asm volatile ("cli");
-
+static void runProc(struct process* p) {
+    PROF_OWNER(0);
     mapProcMem(p);
+    tss_rsp0 = (uint64_t) p->kstack + KSTACK_SIZE;
+    kdata->pid = p->pid;
+    kdata->stdout = p->stdout;
+    kdata->switches++;
+    p->slices++;
+    run_ns = clockNs();
+    ms_since_boot = run_ns / 1000000;
+    slice_end = run_ns + (p->slice_left_ns ? p->slice_left_ns : sliceMs(p->level) * 1000000);
+    p->slice_left_ns = 0;
+    if (tickless && slice_end < timer_ns)
+        setTimer(slice_end);
+
+    if (p->woke_ns) {
+        recordWakeup(run_ns - p->woke_ns);
+        p->woke_ns = 0;
+    }
 
-    uint64_t* sp = (uint64_t*) p->rsp;
-    *--sp = 27;
-    *--sp = p->rsp;
-    *--sp = p->rflags | 0x200;
-    *--sp = 19;
-    *--sp = p->rip;
-
-    *--sp = p->rax;
-    *--sp = p->rbx;
-    *--sp = p->rcx;
-    *--sp = p->rdx;
-    *--sp = p->rsi;
-    *--sp = p->rdi;
-    *--sp = p->rbp;
-    *--sp = p->r8;
-    *--sp = p->r9;
-    *--sp = p->r10;
-    *--sp = p->r11;
-    *--sp = p->r12;
-    *--sp = p->r13;
-    *--sp = p->r14;
-    *--sp = p->r15;
-
-    asm volatile ("mov %0, %%rsp"::"m"(sp));
-
-    asm volatile ("\
-\n      pop %r15                                \
-\n      pop %r14                                \
-\n      pop %r13                                \
-\n      pop %r12                                \
-\n      pop %r11                                \
-\n      pop %r10                                \
-\n      pop %r9                                 \
-\n      pop %r8                                 \
-\n      pop %rbp                                \
-\n      pop %rdi                                \
-\n      pop %rsi                                \
-\n      pop %rdx                                \
-\n      pop %rcx                                \
-\n      pop %rbx                                \
-\n      pop %rax                                \
-\n      iretq                                   \
-    ");
+    switch_stacks(&sched_ksp, p->ksp);
 }
 
 struct app {
@@ -352,52 +469,82 @@ extern uint64_t procs_code[];
 extern uint64_t procs_code_len;
 static struct app procs;
 
+extern uint64_t mem_code[];
+extern uint64_t mem_code_len;
+static struct app mem;
+
+extern uint64_t boot_code[];
+extern uint64_t boot_code_len;
+static struct app boot;
+
 static uint64_t createProc(struct app* a, uint64_t stdout, struct process* parent) {
     struct process *p = mallocz(sizeof(struct process));
+    if (!p)
+        return 0;
+
     p->page = palloc();
+    p->kstack = allocFrames(KSTACK_ORDER);
+    if (!p->page || !p->kstack) {
+        if (p->page) pfree(p->page);
+        if (p->kstack) freeFrames(p->kstack);
+        free(p);
+        return 0;
+    }
+
     p->stdout = stdout;
     p->parent = parent;
-    for (uint64_t i = 0; i < a->len; i++)
-        ((uint64_t*) (p->page))[i] = a->code[i];
-
-    p->r15 = stdout;
-    p->rip = 0x7FC0000000ull;
-    p->rsp = 0x7FC0180000ull;
+    p->nice = p->level = parent ? parent->nice : 0;
+    p->sleep_timer.fire = wakeSleeper;
+    memcpy(p->page, a->code, a->len * sizeof(uint64_t));
+
+    // The first switch to it pops zeros for the callee-saved registers and returns to trap_return, which iretqs to the entry point
+    struct trap_frame* tf = trapFrame(p);
+    memset(tf, 0, sizeof(*tf));
+    tf->r15 = stdout;
+    tf->rip = 0x7FC0000000ull;
+    tf->cs = USER_CS;
+    tf->rsp = 0x7FC0180000ull;
+    tf->ss = USER_SS;
     asm volatile ("\
 \n      pushf                                       \
 \n      pop %%rax                                   \
 \n      mov %%rax, %0                               \
-    " : "=m"(p->rflags));
-
-    p->node = pushListTail(runnableProcs, p); // TODO: I may have assumptions elsewhere that aren't met with this as is...
+    " : "=m"(tf->rflags));
+    tf->rflags |= RFLAGS_IF;
 
-    if (parent) {
-        if (!parent->children)
-            parent->children = newList();
+    uint64_t* sp = (uint64_t*) tf;
+    *--sp = (uint64_t) trap_return;
+    for (int i = 0; i < 6; i++)
+        *--sp = 0;
+    p->ksp = (uint64_t) sp;
 
-        pushListTail(parent->children, p);
-    } else {
-        pushListTail(rootProcs, p);
+    // startSh can be called with interrupts on, so keep the pid table and lists from changing under us
+    no_ints();
+    p->pid = pidTableAdd(pids, p);
+    if (!p->pid) {
+        ints_okay();
+        pfree(p->page);
+        freeFrames(p->kstack);
+        free(p);
+        return 0;
     }
 
-    struct pidMap* pm = malloc(sizeof(struct pidMap));
-    // TODO: Can there be a race condition here?  no_ints / ints_okay around increment of last_pid?  (What about other lists???)
-    // I guess be mindful of what's only called from interrupt handler vs what's not...  TODO: Check this out.
-    p->pid = ++last_pid;
-    pm->pid = p->pid;
-    pm->p = p;
-    struct list* l = pids[p->pid % PIDS_SZ];
-    if (!l) {
-        l = newList();
-        pids[p->pid % PIDS_SZ] = l;
-    }
-    pushListTail(l, pm);
+    makeRunnable(p);
+    pushIListTail(parent ? &parent->children : &rootProcs, &p->sibling_node);
+    ints_okay();
+
+    // Made on the parent's behalf, but they're the new process's to free
+    PROF_CHOWN(p, p->pid);
+    PROF_CHOWN(p->page, p->pid);
 
     return p->pid;
 }
 
 uint64_t startSh(uint64_t stdout) {
-    return createProc(&sh, stdout, 0);
+    uint64_t pid = createProc(&sh, stdout, 0);
+    bootStamp(BOOT_FIRST_SH);
+
+    return pid;
 }
 
 void gotLine(uint64_t pid, char* l) {
@@ -406,47 +553,55 @@ void gotLine(uint64_t pid, char* l) {
     if (!p)
         return;
 
-    p->rax = strlen(l);
-    p->rbx = p->rsp - p->rax - (20 * 8); // We push 20 quadwords onto stack as part of resuming process
+    // Goes below the user stack pointer, leaving the 20 quadwords of room it's always had below it
+    struct trap_frame* tf = trapFrame(p);
+    tf->rax = strlen(l);
+    tf->rbx = tf->rsp - tf->rax - (20 * 8);
 
-    char* s = (char*) (p->page + p->rbx - 0x7FC0000000ull);
-    for (uint64_t i = 0; i < p->rax; i++)
-        s[i] = l[i];
+    memcpy(p->page + tf->rbx - 0x7FC0000000ull, l, tf->rax);
 
-    p->node = pushListTail(runnableProcs, p);
+    wake(p, workQueuedNs() ? workQueuedNs() : clockNs()); // From the keypress that finished the line
 }
 
-void iretqWaitloop();
-
+// Runs on the kernel stack (see resetToWaitloop), and is where each process's kernel stack switches back to when it blocks, is
+//   preempted, or exits.
 void waitloop() {
+    if (!kdata->sched_start_ns)
+        kdata->sched_start_ns = clockNs();
+
     for (;;) {
-        void (*f)();
+        PROF_OWNER(0);
+        resched = 0; // We're about to do whatever it was for; anything that comes in after this sets it again
 
-        while ((f = (void (*)()) pop(&wq)))
-            f();
+        // We get back here from a process by way of an interrupt or syscall, so they're still off; work can take a while (a log
+        //   flush, a redraw), and keypresses and timers shouldn't wait on it
+        asm volatile("sti");
+        runWork();
 
         asm volatile("cli");
 
-        if (curProc)
-            curProc = listItem(nextNodeCirc(runnableProcs, curProc->node));
-        else if (listLen(runnableProcs)) // TODO: I feel like there's a cleaner approach to sort out when I'm less tired...
-            curProc = listItem(listHead(runnableProcs));
+        if (dead_kstack) {
+            freeFrames(dead_kstack);
+            dead_kstack = 0;
+        }
 
-        if (curProc)
-            startProc(curProc);
+        curProc = nextToRun();
+        if (curProc) {
+            runProc(curProc);
+            curProc = 0;
+            continue;
+        }
 
-        asm volatile (
-            "mov %0, %%rsp\n" // We'll never return anywhere or use anything currently on the stack, so reset it
-            "sti\n"
-            "hlt\n"
-            ::"m"(kernel_stack_top)
-        );
-    }
-}
+        // Likely set for the end of the slice of whoever just blocked, which no longer matters
+        uint64_t next = tickless ? nextDeadline(clockNs()) : 0;
+        if (next && next != timer_ns)
+            setTimer(next);
 
-void process_keys() {
-    uint8_t code = (uint8_t) (uint64_t) pop(&kbd_buf);
-    keyScanned(code);
+        uint64_t t = clockNs();
+        asm volatile ("sti; hlt");
+        kdata->idle_ns += clockNs() - t;
+        kdata->idle_wakeups++;
+    }
 }
 
 static void dumpFrame(struct interrupt_frame *frame) {
@@ -454,6 +609,17 @@ static void dumpFrame(struct interrupt_frame *frame) {
     logf("sp: 0x%p016h    ss: 0x%p016h\n", frame->sp, frame->ss);
 }
 
+// A process that faults (or whose syscall faulted) is killed; otherwise all we can do is start waitloop over
+static void __attribute__((noreturn)) faulted(struct interrupt_frame* frame) {
+    if (frame->cs == USER_CS || onKernelStackOf(curProc)) {
+        killProc(curProc);
+        leaveDeadProc();
+    }
+
+    resetToWaitloop();
+    __builtin_unreachable();
+}
+
 static inline void generic_trap_n(struct interrupt_frame *frame, int n) {
     printf("Generic trap handler used for trap vector 0x%h\n", n);
     dumpFrame(frame);
@@ -463,13 +629,14 @@ static inline void generic_trap_n(struct interrupt_frame *frame, int n) {
     //   that or risk jumping to IP.
     // That means we can ignore whether there is an error code on the stack, as waitloop clears stack anyway.
     // So I think this should be a fine generic trap handler to default to when a specific one isn't available.
-    frame->ip = (uint64_t) waitloop;
+    // (A process that caused it is killed rather than left on the run queue to fault again.)
+    faulted(frame);
 }
 
 static inline void generic_etrap_n(struct interrupt_frame *frame, uint64_t error_code, int n) {
     printf("Generic trap handler used for trap vector 0x%h, with error on stack; error: 0x%p016h\n", n, error_code);
     dumpFrame(frame);
-    frame->ip = (uint64_t) waitloop;
+    faulted(frame);
 }
 
 
@@ -556,62 +723,177 @@ static void __attribute__((interrupt)) default_interrupt_handler(struct interrup
     dumpFrame(frame);
 }
 
-extern uint64_t regs[15];
+// Blocks the current process until something wakes it
+static void block() {
+    toWaitloop(curProc);
+}
+
+// Until the clock reads ns; if there's no memory for the timer, it doesn't sleep at all rather than never waking
+static void sleepUntil(uint64_t ns) {
+    no_ints(); // So timerStart leaves them off, and the timer can't go off before we've blocked
+    uint64_t sleeping = ns > clockNs() && timerStart(&curProc->sleep_timer, ns, 0);
+    ints_okay_once_on();
+
+    if (sleeping)
+        block();
+}
+
+// Used up its slice (or gave it up, if yielding): back on the tail of its run queue, a level lower if it was preempted
+static void preempt(struct process* p, int yielding) {
+    if (!yielding) {
+        p->preempted++;
+        if (p->level < PRIO_LEVELS - 1)
+            p->level++;
+    }
+
+    makeRunnable(p);
+    toWaitloop(p);
+}
+
+// Switched out only so something woken can go first, so it's done nothing to be sent to the back: it goes on the front of its run
+//   queue, to pick up again as soon as the woken process is done, with whatever was left of its slice
+static void preemptForWakeup(struct process* p) {
+    uint64_t now = clockNs();
+
+    kdata->wake_preempts++;
+    p->slice_left_ns = slice_end > now ? slice_end - now : 0;
+    pushIListHead(&runQueues[p->level], &p->run_node);
+    runLevels |= 1ull << p->level;
+    toWaitloop(p);
+}
+
+static uint64_t listProcs(struct ilist* l, struct sc_proc* ps, uint64_t n, uint64_t max) {
+    iListForEachItem(p, l, struct process, sibling_node) {
+        if (n < max) {
+            uint64_t cpu_ns = p->cpu_ns + (p == curProc ? clockNs() - run_ns : 0);
+
+            ps[n].pid = p->pid;
+            ps[n].ppid = p->parent ? p->parent->pid : 0;
+            ps[n].nice = p->nice;
+            ps[n].level = p->level;
+            ps[n].running = p == curProc;
+            ps[n].cpu_us = cpu_ns / 1000;
+            ps[n].slices = p->slices;
+            ps[n].preempted = p->preempted;
+        }
+
+        n = listProcs(&p->children, ps, n + 1, max);
+    }
+
+    return n;
+}
 
-void __attribute__((interrupt)) int0x80_syscall(struct interrupt_frame *frame) {
-    if (frame->ip < 511ull * 1024 * 1024 * 1024) // Is it actually useful to test for this?
+// Called by the int0x80 stub with the caller's registers; whatever we leave in f is what it gets back when we return
+void int0x80_syscall(struct trap_frame* f) {
+    if (f->rip < 511ull * 1024 * 1024 * 1024) // Is it actually useful to test for this?
         return;
 
-    for (int i = 0; i < 15; i++)
-        ((uint64_t*) curProc)[i] = regs[i];
-    curProc->rip = frame->ip;
-    curProc->rsp = frame->sp;
-    curProc->rflags = frame->flags;
+    PROF_OWNER(curProc->pid); // Anything allocated from here until we go back to a process is on its behalf
 
-    switch (curProc->rax) {
+    switch (f->rax) {
     case 0: // exit()
         killProc(curProc);
-        iretqWaitloop();
-        break;
+        leaveDeadProc();
     case 2: // printColor(char* s, color c)
         no_ints(); // Printing will disable and then reenable, but we want them to stay off until iretq, so inc count of noes
-        printColorTo(curProc->stdout, (char*) curProc->rbx, (uint8_t) curProc->rcx); // This is a safe way to get just low 8-bits, right?
+        printColorTo(curProc->stdout, (char*) f->rbx, (uint8_t) f->rcx); // This is a safe way to get just low 8-bits, right?
         ints_okay_once_on(); // dec count of noes, so count is restored and iretq turns them on
 
         break;
     case 3: // readline()
+        bootStamp(BOOT_FIRST_PROMPT);
         setReading(curProc->stdout, curProc->pid);
-        removeNodeFromList(runnableProcs, curProc->node);
-        curProc->node = 0;
-        curProc = 0; // TODO: Ideally, we'd go to next runnable proc, not head, as will happen this way...
-        iretqWaitloop();
+        block();
         break;
     case 4: // runProg(char* s)
-        if (!strcmp((char*) curProc->rbx, "app"))
-            curProc->rax = (uint64_t) createProc(&app, curProc->stdout, curProc);
-        else if (!strcmp((char*) curProc->rbx, "sh"))
-            curProc->rax = (uint64_t) createProc(&sh, curProc->stdout, curProc);
-        else if (!strcmp((char*) curProc->rbx, "procs"))
-            curProc->rax = (uint64_t) createProc(&procs, curProc->stdout, curProc);
+        if (!strcmp((char*) f->rbx, "app"))
+            f->rax = (uint64_t) createProc(&app, curProc->stdout, curProc);
+        else if (!strcmp((char*) f->rbx, "sh"))
+            f->rax = (uint64_t) createProc(&sh, curProc->stdout, curProc);
+        else if (!strcmp((char*) f->rbx, "procs"))
+            f->rax = (uint64_t) createProc(&procs, curProc->stdout, curProc);
+        else if (!strcmp((char*) f->rbx, "mem"))
+            f->rax = (uint64_t) createProc(&mem, curProc->stdout, curProc);
+        else if (!strcmp((char*) f->rbx, "boot"))
+            f->rax = (uint64_t) createProc(&boot, curProc->stdout, curProc);
         else
-            curProc->rax = 0;
+            f->rax = 0;
 
-        startProc(curProc); // Huh, okay, so to return something, we need to startProc to set registers; if nothing to return, we can just return from handler
         break;
     case 5: // wait(uint64_t p)
-        struct process* p = procByPid(curProc->rbx);
+        struct process* p = procByPid(f->rbx);
         if (p) {
             p->waiting = curProc;
-            removeNodeFromList(runnableProcs, curProc->node);
-            curProc->node = 0;
-            curProc = 0; // TODO: Ideally, we'd go to next runnable proc, not head, as will happen this way...
-            iretqWaitloop();
+            block();
         } // We just return to caller if no such process (the process the caller is waiting on has already finished)
 
+        break;
+    case 6: // getProcs(struct sc_proc* ps, uint64_t max)
+        f->rax = listProcs(&rootProcs, (struct sc_proc*) f->rbx, 0, f->rcx);
+
+        break;
+    case 7: // kernelHeapStats(struct heap_stats* s)
+        getHeapStats((struct heap_stats*) f->rbx);
+
+        break;
+    case 8: // pageStats(struct sc_page_stats* s)
+        getPageStats((struct sc_page_stats*) f->rbx);
+
+        break;
+    case 9: // bootTimeline(struct sc_boot_timeline* t)
+        getBootTimeline((struct sc_boot_timeline*) f->rbx);
+
+        break;
+    case 10: // nice(uint64_t n)
+        // Only ever down: there's nobody privileged to let back up (children start at their parent's nice), and it doesn't lift
+        //   the process out of a level it's sunk to by using up its slices, either
+        f->rax = curProc->nice;
+        if (f->rbx > curProc->nice)
+            curProc->nice = f->rbx < PRIO_LEVELS ? f->rbx : PRIO_LEVELS - 1;
+        if (curProc->level < curProc->nice)
+            curProc->level = curProc->nice;
+
+        break;
+    case 11: // yield()
+        preempt(curProc, 1);
+
+        break;
+    case 12: // schedStats(struct sc_sched_stats* s)
+        struct sc_sched_stats* ss = (struct sc_sched_stats*) f->rbx;
+        ss->wakeups = kdata->wakeups;
+        ss->wake_preempts = kdata->wake_preempts;
+        memcpy(ss->wake_us, wake_hist, sizeof(wake_hist));
+        ss->tickless = tickless;
+        ss->timer_irqs = kdata->timer_irqs;
+        ss->idle_wakeups = kdata->idle_wakeups;
+        ss->idle_ns = kdata->idle_ns;
+        ss->since_ns = clockNs() - kdata->sched_start_ns;
+
+        break;
+    case 13: // clockGettime(uint64_t clock, struct sc_timespec* ts)
+        f->rax = clockGettime(f->rbx, (struct sc_timespec*) f->rcx);
+
+        break;
+    case 16: // workStats(struct sc_work_stats* ws, uint64_t max)
+        f->rax = getWorkStats((struct sc_work_stats*) f->rbx, f->rcx);
+
+        break;
+    case 14: // sleepNs(uint64_t ns)
+        sleepUntil(clockNs() + f->rbx);
+
+        break;
+    case 15: // sleepUntil(uint64_t ns)
+        sleepUntil(f->rbx);
+
         break;
     default:
-        printf("Unknown syscall 0x%h\n", curProc->rax);
+        printf("Unknown syscall 0x%h\n", f->rax);
     }
+
+    PROF_OWNER(0);
+
+    if (resched && curProc)
+        preemptForWakeup(curProc);
 }
 
 static void __attribute__((interrupt)) default_PIC_P_handler(struct interrupt_frame *frame) {
@@ -631,8 +913,8 @@ static void __attribute__((interrupt)) default_PIC_S_handler(struct interrupt_fr
 
 static void __attribute__((interrupt)) divide_by_zero_handler(struct interrupt_frame *frame) {
     printf("Divide by zero handler\n");
-    frame->ip = (uint64_t) waitloop;
     dumpFrame(frame);
+    faulted(frame);
 }
 
 static void __attribute__((interrupt)) trap_0x0e_page_fault(struct interrupt_frame *frame, uint64_t error_code) {
@@ -650,28 +932,30 @@ static void __attribute__((interrupt)) trap_0x0e_page_fault(struct interrupt_fra
 
     printf("cr2: %p016h\n", cr2);
 
-    if (frame->cs == 0x13)
-        killProc(curProc);
-
-    iretqWaitloop();
+    faulted(frame);
 }
 
 static void __attribute__((interrupt)) double_fault_handler(struct interrupt_frame *frame, uint64_t error_code) {
     printf("Double fault; error should be zero.  error: 0x%p016h\n", error_code);
     dumpFrame(frame);
-    if (frame->ip >= 511ull * 1024 * 1024 * 1024) {
-    }
-    if (frame->cs == 0x13)
-        killProc(curProc);
-    iretqWaitloop();
+    faulted(frame);
 }
 
-static void __attribute__((interrupt)) irq1_kbd(struct interrupt_frame *) {
+// Keypresses are handled in waitloop.  Most just echo, which can wait for the running process to block or use up its slice (a few
+//   ms at most), but Enter with a process waiting on the line wakes it, so the process it interrupts goes back to waitloop right
+//   away, rather than making the reader wait out the slice.
+static void __attribute__((interrupt)) irq1_kbd(struct interrupt_frame *frame) {
     uint8_t code = inb(0x60);
     outb(PIC_PRIMARY_CMD, PIC_ACK);
-    push(&kbd_buf, (void*) (uint64_t) code);
     //printf("[%u]", code);
-    push(&wq, process_keys);
+    queueWork(&key_work, code);
+
+    if (code != SCAN_ENTER || !lineReader())
+        return;
+
+    resched = 1;
+    if (frame->cs == USER_CS && curProc)
+        preemptForWakeup(curProc);
 }
 
 static void __attribute__((interrupt)) irq8_rtc(struct interrupt_frame *) {
@@ -685,39 +969,26 @@ static void __attribute__((interrupt)) irq8_rtc(struct interrupt_frame *) {
 
 static uint64_t cpuCountOffset = 0;
 
-void __attribute__((interrupt)) irq0_pit(struct interrupt_frame *frame) {
+void irq0_pit(struct trap_frame* f) {
     outb(PIC_PRIMARY_CMD, PIC_ACK);
+    kdata->timer_irqs++;
 
-    pitCount++;
-
-    ms_since_boot = pitCount * PIT_COUNT * 1000 / PIT_FREQ;
+    if (!tickless)
+        pitCount++;
+    clockTick();
+    uint64_t now = clockNs();
+    ms_since_boot = now / 1000000;
 
-    if (periodicCallbacks.pcs) {
-        for (uint64_t i = 0; i < periodicCallbacks.len; i++) {
-            if (periodicCallbacks.pcs[i]->count == 0 || periodicCallbacks.pcs[i]->count > TICK_HZ) {
-                printf("halting!\n");
-                //logf("halting!\n");
-                __asm__ __volatile__ ("hlt");
-            }
+    runTimers(now);
 
-            if (pitCount % (TICK_HZ * periodicCallbacks.pcs[i]->period / periodicCallbacks.pcs[i]->count) == 0)
-                push(&wq, periodicCallbacks.pcs[i]->f);
-        }
-    }
+    if (tickless)
+        setTimer(nextDeadline(now));
 
-    static uint64_t lms = 0;
-    if (ms_since_boot >= lms + 2) {
-        lms = ms_since_boot;
-
-        if (frame->ip >= 511ull * 1024 * 1024 * 1024) {
-            for (int i = 0; i < 15; i++)
-                ((uint64_t*) curProc)[i] = regs[i];
-            curProc->rip = frame->ip;
-            curProc->rsp = frame->sp;
-            curProc->rflags = frame->flags;
-
-            iretqWaitloop();
-        }
+    if (f->cs == USER_CS && curProc) {
+        if (now >= slice_end)
+            preempt(curProc, 0);
+        else if (resched)
+            preemptForWakeup(curProc);
     }
 }
 
@@ -742,15 +1013,6 @@ static void init_pit() {
     outb(PIT_CH0_DATA, PIT_COUNT >> 8);
 }
 
-// TODO: Grow queue capacities if appropriate
-    // TODO:
-    // I can have a work queue item that runs periodically (say, every 10 seconds?) that checks capacity
-    //   and usage, and doubles capacity if usage is greater than half of capacity.
-
-static void check_queue_caps() {
-    //logf("kbd_buf now has capacity: %u\n", kbd_buf.cap);
-}
-
 void init_interrupts() {
     no_ints();
     for (int i = 32; i < 40; i++)
@@ -788,14 +1050,13 @@ void init_interrupts() {
     init_rtc();
     init_pit();
     init_pic();
-    INITQ(wq, INIT_WQ_CAP);
-    INITQ(kbd_buf, INIT_KB_CAP);
 
     cpuCountOffset = read_tsc();
 
-    registerPeriodicCallback((struct periodic_callback) {1, 2, check_queue_caps});
+    registerPeriodicCallback((struct periodic_callback) {1, 2, checkWorkQueues, "queue check"});
+
+    pids = newPidTable(PID_MAX);
 
-    runnableProcs = newList();
     //__asm__ __volatile__ ("xchgw %bx, %bx");
 
     app.code = &app_code[0];
@@ -807,5 +1068,11 @@ void init_interrupts() {
     procs.code = &procs_code[0];
     procs.len = procs_code_len;
 
+    mem.code = &mem_code[0];
+    mem.len = mem_code_len;
+
+    boot.code = &boot_code[0];
+    boot.len = boot_code_len;
+
     ints_okay();
 }
@@ -5,15 +5,31 @@
 #include "log.h"
 
 void init_interrupts();
+uint64_t read_tsc();
 void waitloop();
+void resetToWaitloop(); // bootloader.asm
 uint64_t startSh(uint64_t stdout);
 void gotLine(uint64_t pid, char* l);
+void init_tickless();
+void rearmTimer();
+uint64_t pitClocks();
 
 extern uint64_t int_blocks;
 extern uint64_t* kernel_stack_top;
 
+// Unlike read_tsc, doesn't wait for earlier instructions to finish first, so it's as cheap as reading the time gets
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+
+    return (uint64_t) hi << 32 | lo;
+}
+
+// Without KERNEL it's a host benchmark built from a kernel source (see the Makefile), and there's no turning interrupts off
 static inline void no_ints() {
+#ifdef KERNEL
     asm volatile("cli");
+#endif
     int_blocks++;
 }
 
@@ -29,6 +45,8 @@ static inline void ints_okay_once_on() {
 static inline void ints_okay() {
     ints_okay_once_on();
 
+#ifdef KERNEL
     if (int_blocks == 0)
         asm volatile("sti");
+#endif
 }
@@ -1,22 +1,25 @@
 #include <stdint.h>
 
 #include "acpi.h"
+#include "clock.h"
+#include "alloc_profile.h"
+#include "boot_timeline.h"
 #include "console.h"
 #include "hpet.h"
 #include "interrupt.h"
 #include "log.h"
+#include "mem_bench.h"
+#include "pages.h"
+#include "paging.h"
 #include "serial.h"
 
 #include "../lib/malloc.h"
 #include "../lib/strings.h"
+#include "../lib/syscall.h"
 
-struct mem_table_entry {
-    uint64_t start : 64;
-    uint64_t length : 64;
-    uint64_t type : 64;
-};
-
-#define STACK_SIZE (64 * 1024)
+#define STACK_ORDER 4 // 64 KB worth of 4 KB frames
+#define STACK_SIZE (4096 << STACK_ORDER)
+#define HEAP_SHARE 4 // The byte heap gets (up to) 1/HEAP_SHARE of memory; the rest is left for process pages
 
 /*
   Overall to-do list:
@@ -83,56 +86,72 @@ struct mem_table_entry {
 
 void __attribute__((section(".kernel_entry"))) kernel_entry() {
     uint32_t* entry_count = (uint32_t*) 0x4000;
-    uint64_t largest = 0;
-    uint32_t il;
     struct mem_table_entry* mem_table = (struct mem_table_entry*) 0x4004;
-    for (uint32_t i = 0; i < *entry_count; i++) {
-        if (mem_table[i].type != 1)
-            continue;
-
-        // L2 pages mapping first 256 GB of address space take up the MB from 0x100000 to 0x200000
-        // At some point I'll probably want to make that part of this process, but for now it's fixed there,
-        //   and we'll just account for it here.
-        if (mem_table[i].start < 0x300000) {
-            if (mem_table[i].start + mem_table[i].length < 0x300000) {
-                mem_table[i].type = 2;
-                continue;
-            }
-
-            mem_table[i].length -= 0x300000 - mem_table[i].start;
-            mem_table[i].start = 0x300000;
-        }
-
-        if (mem_table[i].length > largest) {
-            largest = mem_table[i].length;
-            il = i;
-        }
-    }
+    struct sc_page_stats ps;
+
+    no_ints(); // Allocating frames would otherwise turn interrupts on before there's anything to handle them
+    init_boot_timeline();
+
+    uint64_t map_start = read_tsc();
+    uint64_t mapped_end = init_paging(mem_table, *entry_count);
+    uint64_t map_cycles = read_tsc() - map_start;
+    bootStamp(BOOT_PAGING);
+
+    init_pages(mem_table, *entry_count, mapped_end);
+    getPageStats(&ps);
+    bootStamp(BOOT_PAGES);
+
+    kernel_stack_top = (uint64_t*) ((uint64_t) allocFrames(STACK_ORDER) + STACK_SIZE);
+#ifdef ALLOC_PROFILE
+    init_alloc_profile();
+#endif
 
-    kernel_stack_top = (uint64_t*) ((mem_table[il].start + STACK_SIZE) & ~0b1111ull);
-    init_heap(kernel_stack_top, mem_table[il].length - STACK_SIZE);
+    uint64_t heap_size;
+    uint64_t* heap_start = allocFramesUpTo(ps.managed / HEAP_SHARE, &heap_size);
+    init_heap(heap_start, heap_size);
+    bootStamp(BOOT_HEAP);
 
     init_interrupts();
+    ints_okay();
+    bootStamp(BOOT_INTERRUPTS);
     init_com1();
+    bootStamp(BOOT_COM1);
     no_ints();
     startTty();
+    bootStamp(BOOT_TTY);
+    init_log_sinks();
 
     logf("We've got %u mem table entries:\n", *entry_count);
     for (uint32_t i = 0; i < *entry_count; i++) {
         logf("0x%p016h - 0x%p016h : %u\n", mem_table[i].start,
                mem_table[i].start + mem_table[i].length - 1, mem_table[i].type);
     }
-    logf("Largest memory region: 0x%p016h - 0x%p016h\n", mem_table[il].start, mem_table[il].start + largest - 1);
-    logf("Stack top / heap bottom: 0x%h\n", kernel_stack_top);
+    logf("Usable memory: %u MB; managed: %u MB\n", ps.usable / 1024 / 1024, ps.managed / 1024 / 1024);
+    logf("Direct map: %u page-table pages, built in %u cycles\n", pageTablePages(), map_cycles);
+    if (mapped_end < DIRECT_MAP_END)
+        logl(LOG_ERROR, "Ran out of page-table pages; nothing past %u GB is mapped, so that memory goes unused\n", mapped_end >> 30);
+    logf("Stack top: 0x%h\n", kernel_stack_top);
     logf("Heap is %u MB.\n", heapSize() / 1024 / 1024);
+    getPageStats(&ps);
+    logf("%u of %u 2 MB pages free for processes.\n", ps.free, ps.total);
     parse_acpi_tables();
+    bootStamp(BOOT_ACPI);
     init_hpet();
+    init_clock();
+#ifndef PERIODIC_TICK
+    init_tickless();
+#endif
+    bootStamp(BOOT_HPET);
+    reportBootTimeline();
+#ifdef MEM_BENCH
+    reportMemBench();
+#endif
 
     extern uint8_t tss;
     *((void**) (&tss + 4)) = kernel_stack_top;
 
-    logf("Set up heap with 0x%h, %u\n", kernel_stack_top, mem_table[il].length - STACK_SIZE);
+    logf("Set up heap with 0x%h, %u\n", heap_start, heap_size);
 
     log("Kernel initialized; going to waitloop.\n");
-    waitloop();
+    resetToWaitloop();
 }
@@ -5,7 +5,8 @@
 #include "interrupt.h"
 #include "io.h"
 
-#include "../lib/list.h"
+#include "../lib/malloc.h"
+#include "../lib/vector.h"
 
 // https://www.win.tue.nl/~aeb/linux/kbd/scancodes-1.html
 
@@ -20,15 +21,15 @@ static uint8_t alt_down = 0;
 static uint8_t caps_lock_on = 0; // We really mean 0 as unchanged from what it initially was...
 static uint8_t last_e0 = 0;
 
-static struct list* inputCallbackList = (struct list*) 0;
+typedef void (*kbd_listener)(struct input);
+DEFINE_VECTOR(kbd_listeners, kbd_listener)
 
+static struct kbd_listeners inputCallbacks;
+
+// Most recently registered first, as they always have been
 static inline void gotInput(struct input c) {
-    forEachListItem(inputCallbackList, ({
-        void __fn__ (void* item) {
-            ((void (*)(struct input)) item)(c);
-        }
-        __fn__;
-    }));
+    for (uint64_t i = inputCallbacks.len; i > 0; i--)
+        inputCallbacks.items[i - 1](c);
 }
 
 static inline void kbd_out(uint8_t val) {
@@ -226,15 +227,11 @@ void keyScanned(uint8_t c) {
 }
 
 void registerKbdListener(void (*f)(struct input)) {
-    if (!inputCallbackList)
-        inputCallbackList = newList();
-
-    pushListHead(inputCallbackList, f);
+    kbd_listenersPush(&inputCallbacks, f);
 }
 
 void unregisterKbdListener(void (*f)(struct input)) {
-    if (!inputCallbackList)
-        return;
-
-    removeFromList(inputCallbackList, f);
+    for (uint64_t i = 0; i < inputCallbacks.len; i++)
+        if (inputCallbacks.items[i] == f)
+            kbd_listenersRemoveAt(&inputCallbacks, i--);
 }
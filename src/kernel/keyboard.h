@@ -61,6 +61,8 @@ struct input {
 #define KEY_HOME 30
 #define KEY_END 31
 
+#define SCAN_ENTER 0x1c // Make code for Enter (and, after 0xe0, keypad Enter): the only key that can finish a line
+
 void keyScanned(uint8_t c);
 void registerKbdListener(void (*)(struct input));
 void unregisterKbdListener(void (*)(struct input));
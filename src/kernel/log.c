@@ -1,44 +1,270 @@
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "log.h"
 
+#include "boot_timeline.h"
 #include "console.h"
+#include "interrupt.h"
+#include "io.h"
+#include "periodic_callback.h"
+#include "serial.h"
 
-#include "../lib/list.h"
+#include "../lib/arena.h"
+#include "../lib/mem.h"
 #include "../lib/strings.h"
 
-static struct list* logs = (struct list*) 0;
+// Logging just records the format string and raw arguments (copying any strings, since they may not outlive the call) into a
+//   fixed ring of records, with no formatting or allocation, so it's cheap and safe from interrupt handlers.  Sinks each keep
+//   a cursor into the ring and format records as they get to them; if they fall more than a ring's worth behind, they lose the
+//   oldest and are told how many.
+//
+// Writers claim a sequence number with an atomic increment, so an interrupt handler logging in the middle of someone else's log
+//   call just gets the next record.  A record's `commit' is its sequence number plus one once it's fully written, which is how a
+//   reader tells a finished record from one still being written or one that has since been reused.
 
-void log(char* s) {
-    if (!logs)
-        logs = newList();
+#define LOG_RECORDS 128 // Power of two
+#define LOG_ARGS 8
+#define LOG_STRS 160 // Bytes for copies of %s arguments, making records 256 bytes
+#define LOG_DRAIN_HZ 20
+#define LOG_LINE 256
+
+struct log_record {
+    uint64_t commit;
+    uint64_t tsc;
+    char* fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t strs_used;
+    uint64_t args[LOG_ARGS]; // For %s, offset into strs
+    char strs[LOG_STRS];
+};
+
+static struct log_record ring[LOG_RECORDS];
+static uint64_t next_seq = 0;
+
+// Skips past the conversion at *p (just after the '%'), returning its type character ('%' for a literal one, 0 for nonsense)
+static char* conversion(char* p, char* type) {
+    if (*p == 'p') { // Padding: %p<pad char><width><type>
+        if (!p[1] || p[2] < '0' || p[2] > '9') {
+            *type = 0;
+            return p[1] ? p + 2 : p + 1;
+        }
+
+        for (p += 2; *p >= '0' && *p <= '9'; p++)
+            ;
+    }
+
+    *type = *p;
+
+    return *p ? p + 1 : p;
+}
+
+static uint16_t copyStr(struct log_record* r, char* s) {
+    uint16_t start = r->strs_used;
+    uint64_t room = LOG_STRS - start - 1;
+    uint64_t len = s ? strlen(s) : 0;
+
+    if (len > room) { // Keep a trailing newline, so a too-long line is still a line
+        uint64_t nl = s[len - 1] == '\n';
+        uint64_t keep = room > 3 + nl ? room - 3 - nl : 0;
+        for (uint64_t i = 0; i < keep; i++)
+            r->strs[start + i] = s[i];
+        for (uint64_t i = keep; i < keep + 3 && i < room; i++)
+            r->strs[start + i] = '.';
+        if (nl && room > 3)
+            r->strs[start + keep + 3] = '\n';
+        len = room;
+    } else {
+        for (uint64_t i = 0; i < len; i++)
+            r->strs[start + i] = s[i];
+    }
+
+    r->strs[start + len] = 0;
+    r->strs_used = start + len + 1;
+
+    return start;
+}
 
-    // TODO: Include timestamp of log.
-    // I could just do an int64_t and format when showing, but I think I like formatting now and just storing
-    //   the string?
-    pushListTail(logs, M_scopy(s));
+static void record(uint8_t level, char* fmt, va_list ap) {
+    uint64_t seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    struct log_record* r = &ring[seq & (LOG_RECORDS - 1)];
 
-    printTo(LOGS_TERM, s);
+    __atomic_store_n(&r->commit, 0, __ATOMIC_RELEASE);
+    r->tsc = rdtsc();
+    r->fmt = fmt;
+    r->level = level;
+    r->nargs = 0;
+    r->strs_used = 0;
+
+    for (char* p = fmt; *p && r->nargs < LOG_ARGS;) {
+        if (*p++ != '%')
+            continue;
+
+        char type;
+        p = conversion(p, &type);
+
+        if (type == 's')
+            r->args[r->nargs++] = copyStr(r, va_arg(ap, char*));
+        else if (type == 'c')
+            r->args[r->nargs++] = (uint64_t) va_arg(ap, int);
+        else if (type == 'u' || type == 'h')
+            r->args[r->nargs++] = va_arg(ap, uint64_t);
+    }
+
+    __atomic_store_n(&r->commit, seq + 1, __ATOMIC_RELEASE);
+}
+
+void log(char* s) {
+    logl(LOG_INFO, "%s", s);
 }
 
 void logf(char* fmt, ...) {
-    VARIADIC_PRINT(log);
+    va_list ap;
+    va_start(ap, fmt);
+    record(LOG_INFO, fmt, ap);
+    va_end(ap);
 }
 
-void* forEachLog(void (*f)(char*)) {
-    return forEachListItem(logs, ({
-        void __fn__ (void* s) {
-            f((char*) s);
+void logl(uint8_t level, char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    record(level, fmt, ap);
+    va_end(ap);
+}
+
+// Formats r into buf one conversion at a time, handing each to the builder with its own argument
+static uint64_t format(struct log_record* r, char* buf, uint64_t cap) {
+    struct sbuf b;
+    sbInit(&b, buf, cap);
+    uint64_t arg = 0;
+
+    if (tsc_hz) {
+        uint64_t ms = (r->tsc - bootTsc()) / (tsc_hz / 1000);
+        sbPrintf(&b, "[%p 5u.%p03u] ", ms / 1000, ms % 1000);
+    }
+
+    for (char* p = r->fmt; *p && !b.truncated;) {
+        char* lit = p;
+        while (*p && *p != '%')
+            p++;
+        sbAppendN(&b, lit, p - lit);
+
+        if (!*p)
+            break;
+
+        char spec[24], type;
+        char* end = conversion(p + 1, &type);
+        uint64_t n = end - p;
+        if (n >= sizeof(spec))
+            n = sizeof(spec) - 1;
+        memcpy(spec, p, n);
+        spec[n] = 0;
+        p = end;
+
+        if (type == 's' || type == 'c' || type == 'u' || type == 'h') {
+            if (arg >= r->nargs)
+                break;
+
+            uint64_t a = r->args[arg++];
+            if (type == 's')
+                sbPrintf(&b, spec, r->strs + a);
+            else
+                sbPrintf(&b, spec, a);
+        } else {
+            sbPrintf(&b, spec);
         }
-        __fn__;
-    }));
+    }
+
+    return b.len;
 }
 
-void* forEachNewLog(void* last, void (*f)(char*)) {
-    return forEachNewListItem(last, ({
-        void __fn__ (void* s) {
-            f((char*) s);
+// Formats the next record for c into buf, returning its length (0 if there's nothing new yet)
+uint64_t readLog(struct log_cursor* c, char* buf, uint64_t cap) {
+    for (;;) {
+        uint64_t head = __atomic_load_n(&next_seq, __ATOMIC_ACQUIRE);
+        if (head - c->seq > LOG_RECORDS) {
+            c->dropped += head - LOG_RECORDS - c->seq;
+            c->seq = head - LOG_RECORDS;
         }
-        __fn__;
-    }));
+
+        if (c->seq == head)
+            return 0;
+
+        // Take a copy, then make sure it wasn't reused by a handler while we copied
+        struct log_record* r = &ring[c->seq & (LOG_RECORDS - 1)];
+        uint64_t commit = __atomic_load_n(&r->commit, __ATOMIC_ACQUIRE);
+        if (commit == 0 || commit < c->seq + 1) // Still being written
+            return 0;
+
+        struct log_record copy = *r;
+        if (commit != c->seq + 1 || __atomic_load_n(&r->commit, __ATOMIC_ACQUIRE) != commit) {
+            c->dropped++;
+            c->seq++;
+            continue;
+        }
+
+        c->seq++;
+        c->level = copy.level;
+
+        return format(&copy, buf, cap);
+    }
+}
+
+struct log_sink {
+    struct log_cursor cur;
+    void (*write)(uint8_t level, char* s);
+};
+
+static void toTerm(uint8_t level, char* s) {
+    printColorTo(LOGS_TERM, s, level == LOG_ERROR ? 0x0c : level == LOG_WARN ? 0x0e : 0x07);
+}
+
+static void toCom1(uint8_t, char* s) {
+    com1_print(s);
+}
+
+// QEMU's -debugcon (or Bochs' port e9 hack) shows whatever's written here
+static void toDebugcon(uint8_t, char* s) {
+    while (*s)
+        outb(0xe9, *s++);
+}
+
+static struct log_sink sinks[] = {
+    {{0, 0, 0}, toTerm},
+    {{0, 0, 0}, toCom1},
+    {{0, 0, 0}, toDebugcon},
+};
+
+static uint64_t draining = 0;
+
+void flushLogs() {
+    char line[LOG_LINE];
+
+    // A sink that logs (or a handler that flushes) while we're at it would print things out of order
+    if (__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE))
+        return;
+
+    for (uint64_t s = 0; s < sizeof(sinks) / sizeof(sinks[0]); s++) {
+        uint64_t dropped = sinks[s].cur.dropped;
+        uint64_t n;
+
+        while ((n = readLog(&sinks[s].cur, line, LOG_LINE))) {
+            if (sinks[s].cur.dropped != dropped) {
+                char note[64];
+                sinks[s].write(LOG_WARN, sprintf(note, 64, "[%u log records dropped]\n", sinks[s].cur.dropped - dropped));
+                dropped = sinks[s].cur.dropped;
+            }
+
+            sinks[s].write(sinks[s].cur.level, line);
+        }
+    }
+
+    __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+}
+
+// Until this is called, records just accumulate (and the oldest get dropped if there are too many)
+void init_log_sinks() {
+    flushLogs();
+    registerPeriodicCallback((struct periodic_callback) {LOG_DRAIN_HZ, 1, flushLogs, "log drain"});
 }
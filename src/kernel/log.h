@@ -1,6 +1,21 @@
 #pragma once
 
+#include <stdint.h>
+
+#define LOG_INFO 0
+#define LOG_WARN 1
+#define LOG_ERROR 2
+
+// Where a reader is in the log; zeroed means the oldest record still around
+struct log_cursor {
+    uint64_t seq;
+    uint64_t dropped; // Records overwritten before this reader got to them
+    uint8_t level; // Of the record last read
+};
+
 void log(char* s);
 void logf(char* fmt, ...);
-void* forEachLog(void (*f)(char*));
-void* forEachNewLog(void* last, void (*f)(char*));
+void logl(uint8_t level, char* fmt, ...);
+uint64_t readLog(struct log_cursor* c, char* buf, uint64_t cap);
+void init_log_sinks();
+void flushLogs();
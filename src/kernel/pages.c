@@ -0,0 +1,252 @@
+#include <stdint.h>
+
+#include "pages.h"
+
+#include "alloc_profile.h"
+#include "interrupt.h"
+#include "log.h"
+#include "paging.h"
+
+#include "../lib/syscall.h"
+
+/*
+  Physical memory is handed out by a buddy allocator over every range the e820 table says is usable.  A block is 2^order 4 KB
+    frames, aligned to its size, so a block's buddy is just its frame number with one bit flipped, and freeing a block merges it
+    with its buddy for as long as the buddy is free too.  Each frame has a byte of metadata saying whether it's the head of a free
+    or an allocated block, and the block's order; free blocks are on a doubly-linked list per order, with the links kept in the
+    free memory itself.
+
+  The kernel heap is one big block taken at boot, and processes' 2 MB pages are order 9 blocks, so they're always 2 MB aligned.
+*/
+
+#define FRAME_SZ 4096ull
+#define FRAME_SHIFT 12
+#define PAGE_ORDER 9 // 2 MB
+#define MAX_ORDER 18 // 1 GB
+
+#define META_FREE  0x80
+#define META_ALLOC 0x40
+#define META_ORDER 0x3f
+
+
+struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+};
+
+static uint8_t* meta;
+static uint64_t nframes; // Frames covered by meta, starting from address 0
+static uint64_t map_end; // Where the direct map stops; nothing past it can be touched, so nothing past it is managed
+static struct free_block* free_lists[MAX_ORDER + 1];
+
+static uint64_t usable, managed;              // Bytes
+static uint64_t free_pages, low_pages, total_pages; // In 2 MB pages, counting free blocks of order 9 and up
+
+static inline void* frame_addr(uint64_t f) {
+    return (void*) (f << FRAME_SHIFT);
+}
+
+static void push_block(uint64_t f, uint64_t order) {
+    struct free_block* b = frame_addr(f);
+
+    b->prev = 0;
+    b->next = free_lists[order];
+    if (b->next)
+        b->next->prev = b;
+    free_lists[order] = b;
+
+    meta[f] = META_FREE | order;
+    if (order >= PAGE_ORDER)
+        free_pages += 1ull << (order - PAGE_ORDER);
+}
+
+static void unlink_block(uint64_t f, uint64_t order) {
+    struct free_block* b = frame_addr(f);
+
+    if (b->prev)
+        b->prev->next = b->next;
+    else
+        free_lists[order] = b->next;
+    if (b->next)
+        b->next->prev = b->prev;
+
+    meta[f] = 0;
+    if (order >= PAGE_ORDER)
+        free_pages -= 1ull << (order - PAGE_ORDER);
+}
+
+// Call with interrupts off
+static void release(uint64_t f, uint64_t order) {
+    for (; order < MAX_ORDER; order++) {
+        uint64_t b = f ^ (1ull << order);
+        if (b + (1ull << order) > nframes || meta[b] != (META_FREE | order))
+            break;
+
+        unlink_block(b, order);
+        f &= b;
+    }
+
+    push_block(f, order);
+}
+
+// Frames s through e - 1, as the biggest blocks their alignment allows
+static void add_range(uint64_t s, uint64_t e) {
+    managed += (e - s) * FRAME_SZ;
+
+    while (s < e) {
+        uint64_t order = s ? __builtin_ctzll(s) : MAX_ORDER;
+        if (order > MAX_ORDER)
+            order = MAX_ORDER;
+        while (s + (1ull << order) > e)
+            order--;
+
+        release(s, order);
+        s += 1ull << order;
+    }
+}
+
+// Usable part of a table entry, in whole frames; returns whether there's anything left
+static int clip(struct mem_table_entry* m, uint64_t* s, uint64_t* e) {
+    // Below page_tables_end is BIOS stuff, the kernel image, and page tables
+    *s = m->start < page_tables_end ? page_tables_end : m->start;
+    *e = m->start + m->length > map_end ? map_end : m->start + m->length;
+
+    *s = (*s + FRAME_SZ - 1) >> FRAME_SHIFT;
+    *e >>= FRAME_SHIFT;
+
+    return m->type == 1 && *s < *e;
+}
+
+void init_pages(struct mem_table_entry* table, uint32_t count, uint64_t mapped_end) {
+    uint64_t s, e;
+
+    map_end = mapped_end;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (table[i].type != 1)
+            continue;
+
+        usable += table[i].length;
+        if (clip(&table[i], &s, &e) && e > nframes)
+            nframes = e;
+    }
+
+    // Metadata goes at the start of the first range with room for it
+    uint64_t meta_frames = (nframes + FRAME_SZ - 1) >> FRAME_SHIFT;
+    uint64_t mi;
+    for (mi = 0; mi < count; mi++)
+        if (clip(&table[mi], &s, &e) && e - s >= meta_frames)
+            break;
+
+    if (mi == count) {
+        nframes = 0;
+        return;
+    }
+
+    meta = frame_addr(s);
+    for (uint64_t i = 0; i < nframes; i++)
+        meta[i] = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!clip(&table[i], &s, &e))
+            continue;
+
+        if (i == mi)
+            s += meta_frames;
+
+        if (s < e)
+            add_range(s, e);
+    }
+
+    total_pages = low_pages = free_pages;
+}
+
+void* allocFrames(uint64_t order) {
+    if (order > MAX_ORDER)
+        return 0;
+
+    no_ints();
+
+    uint64_t k = order;
+    while (k <= MAX_ORDER && !free_lists[k])
+        k++;
+
+    if (k > MAX_ORDER) {
+        ints_okay();
+        return 0;
+    }
+
+    uint64_t f = (uint64_t) free_lists[k] >> FRAME_SHIFT;
+    unlink_block(f, k);
+
+    while (k > order) { // Keep the bottom half, free the top
+        k--;
+        push_block(f + (1ull << k), k);
+    }
+
+    meta[f] = META_ALLOC | order;
+    if (free_pages < low_pages)
+        low_pages = free_pages;
+
+    ints_okay();
+    return frame_addr(f);
+}
+
+// Biggest single block there's room for, up to maxBytes
+void* allocFramesUpTo(uint64_t maxBytes, uint64_t* gotBytes) {
+    if (maxBytes < FRAME_SZ)
+        return 0;
+
+    uint64_t order = 63 - __builtin_clzll(maxBytes >> FRAME_SHIFT);
+    if (order > MAX_ORDER)
+        order = MAX_ORDER;
+
+    for (;; order--) {
+        void* p = allocFrames(order);
+        if (p) {
+            *gotBytes = FRAME_SZ << order;
+            return p;
+        }
+
+        if (order == 0)
+            return 0;
+    }
+}
+
+void freeFrames(void* p) {
+    uint64_t f = (uint64_t) p >> FRAME_SHIFT;
+
+    no_ints();
+
+    if ((uint64_t) p % FRAME_SZ || f >= nframes || !(meta[f] & META_ALLOC)) {
+        ints_okay();
+        logf("WARNING: freeFrames of 0x%h, which isn't an allocated block\n", p);
+        return;
+    }
+
+    uint64_t order = meta[f] & META_ORDER;
+    meta[f] = 0;
+    release(f, order);
+
+    ints_okay();
+}
+
+void* palloc() {
+    void* p = allocFrames(PAGE_ORDER);
+    PROF_ALLOC(p, FRAME_SZ << PAGE_ORDER);
+    return p;
+}
+
+void pfree(void* p) {
+    PROF_FREE(p);
+    freeFrames(p);
+}
+
+void getPageStats(struct sc_page_stats* s) {
+    s->page_size = FRAME_SZ << PAGE_ORDER;
+    s->total = total_pages;
+    s->free = free_pages;
+    s->low = low_pages;
+    s->usable = usable;
+    s->managed = managed;
+}
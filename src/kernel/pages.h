@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+struct sc_page_stats;
+
+struct mem_table_entry {
+    uint64_t start : 64;
+    uint64_t length : 64;
+    uint64_t type : 64;
+};
+
+void init_pages(struct mem_table_entry* table, uint32_t count, uint64_t mapped_end);
+void* allocFrames(uint64_t order);
+void* allocFramesUpTo(uint64_t maxBytes, uint64_t* gotBytes);
+void freeFrames(void* p);
+void* palloc();
+void pfree(void* p);
+void getPageStats(struct sc_page_stats* s);
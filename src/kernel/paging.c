@@ -0,0 +1,131 @@
+#include <stdint.h>
+
+#include "paging.h"
+
+#include "cpuid.h"
+#include "pages.h"
+
+#include "../lib/syscall.h"
+
+/*
+  The bootloader only identity-maps the first GB, which is plenty to get us here.  Now we build the real direct map: the first
+    4 GB (where the firmware, ACPI tables, and devices like the HPET live), plus whatever the e820 table says is out there above
+    that.  We use 1 GB pages if the CPU has them; otherwise, or for GBs only partly covered by the table, 2 MB pages.
+
+  Page-table pages come from 0x100000 up (where the bootloader used to build a full MB of l2 tables), and whatever we don't use
+    of that area goes to the page allocator.  The kernel data page comes from there too, since it's needed before the page
+    allocator's up (irq0 counts into it) and is only ever mapped at 4 KB.  Those, and the tables every process needs, come first,
+    so if the area runs out it's only the direct map that comes up short, and init_pages is told where it stops.
+*/
+
+#define PT_AREA_START 0x100000ull
+#define PT_AREA_END   0x300000ull
+#define GB (1ull << 30)
+#define MB2 (2ull << 20)
+#define LOW_MAP_GB 4
+
+#define CPUID_EXT_MAX 0x80000000
+#define CPUID_EXT_FEATURES 0x80000001
+#define CPUID_PDPE1GB (1 << 26)
+
+uint64_t* proc_l2;
+struct sc_kdata* kdata;
+uint64_t page_tables_end = PT_AREA_START;
+
+static uint64_t* pt_alloc() {
+    if (page_tables_end >= PT_AREA_END)
+        return 0;
+
+    uint64_t* t = (uint64_t*) page_tables_end;
+    page_tables_end += 4096;
+
+    for (int i = 0; i < 512; i++)
+        t[i] = 0;
+
+    return t;
+}
+
+// Nothing's set up to report it with yet (not even the heap, for log), so this is as loud as it gets
+static void __attribute__((noreturn)) noTables() {
+    for (;;)
+        asm volatile ("cli; hlt");
+}
+
+// Whether any table entry touches [start, end), and whether any single one covers all of it
+static void coverage(struct mem_table_entry* table, uint32_t count, uint64_t start, uint64_t end, int* any, int* all) {
+    *any = *all = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t s = table[i].start, e = table[i].start + table[i].length;
+
+        if (s < end && e > start)
+            *any = 1;
+        if (table[i].type == 1 && s <= start && e >= end)
+            *all = 1;
+    }
+}
+
+uint64_t init_paging(struct mem_table_entry* table, uint32_t count) {
+    int gb_pages = cpuid(CPUID_EXT_MAX).eax >= CPUID_EXT_FEATURES &&
+        (cpuid(CPUID_EXT_FEATURES).edx & CPUID_PDPE1GB);
+
+    uint64_t* l3 = pt_alloc();
+    proc_l2 = pt_alloc();
+    uint64_t* kdata_l1 = pt_alloc();
+    kdata = (struct sc_kdata*) pt_alloc();
+    if (!kdata)
+        noTables();
+
+    uint64_t mapped_end = DIRECT_MAP_END;
+
+    for (uint64_t g = 0; g < DIRECT_MAP_END / GB; g++) {
+        int any, all;
+        coverage(table, count, g * GB, (g + 1) * GB, &any, &all);
+
+        if (g < LOW_MAP_GB)
+            any = all = 1;
+        if (!any)
+            continue;
+
+        if (gb_pages && all) {
+            l3[g] = g * GB | PT_PRESENT | PT_WRITABLE | PT_HUGE;
+            continue;
+        }
+
+        uint64_t* l2 = pt_alloc();
+        if (!l2) {
+            mapped_end = g * GB;
+            break;
+        }
+
+        for (uint64_t m = 0; m < 512; m++) {
+            uint64_t a = g * GB + m * MB2;
+            int any_2mb = all, all_2mb;
+
+            if (!all)
+                coverage(table, count, a, a + MB2, &any_2mb, &all_2mb);
+            if (any_2mb)
+                l2[m] = a | PT_PRESENT | PT_WRITABLE | PT_HUGE;
+        }
+
+        l3[g] = (uint64_t) l2 | PT_PRESENT | PT_WRITABLE;
+    }
+
+    l3[511] = (uint64_t) proc_l2 | PT_PRESENT | PT_WRITABLE | PT_USERMODE;
+
+    // Every process sees the kernel data page in the 4 KB just past its 2 MB page, read-only; we write it through the direct map
+    kdata_l1[0] = (uint64_t) kdata | PT_PRESENT | PT_USERMODE;
+    proc_l2[1] = (uint64_t) kdata_l1 | PT_PRESENT | PT_WRITABLE | PT_USERMODE;
+
+    // Same l4 the bootloader set up (which is in cr3 already); just swap in the new l3
+    uint64_t* l4;
+    asm volatile ("mov %%cr3, %0" : "=r"(l4));
+    l4[0] = (uint64_t) l3 | PT_PRESENT | PT_WRITABLE | PT_USERMODE;
+    asm volatile ("mov %0, %%cr3" :: "r"(l4) : "memory");
+
+    return mapped_end;
+}
+
+uint64_t pageTablePages() {
+    return (page_tables_end - PT_AREA_START) / 4096;
+}
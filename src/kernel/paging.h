@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#define PT_PRESENT  1
+#define PT_WRITABLE 1 << 1
+#define PT_USERMODE 1 << 2
+#define PT_HUGE     1 << 7
+
+#define DIRECT_MAP_END (511ull << 30) // The last GB of the first l4 entry is where processes live
+
+struct mem_table_entry;
+struct sc_kdata;
+
+extern uint64_t* proc_l2;
+extern struct sc_kdata* kdata;
+extern uint64_t page_tables_end;
+
+uint64_t init_paging(struct mem_table_entry* table, uint32_t count); // Returns where the direct map ends
+uint64_t pageTablePages();
@@ -1,9 +1,11 @@
 #include <stdint.h>
 
 #include "periodic_callback.h"
-#include "periodic_callback_int.h"
 
+#include "clock.h"
 #include "interrupt.h"
+#include "timer.h"
+#include "work.h"
 
 #include "../lib/list.h"
 #include "../lib/malloc.h"
@@ -11,12 +13,35 @@
 
 #define INIT_CAP 10
 
-struct periodic_callbacks periodicCallbacks = {0, 0};
-
+// Each callback is a periodic timer that queues f for waitloop, due whenever the clock crosses a multiple of its period (in ns,
+//   so 60 a second is every 16666666 ns, not every 16 ms).  It's low-priority coalescing work, so if waitloop falls behind it's
+//   run once, not once for every period missed.
+//
+// Unregistering only stops the timer: the work may still be queued, and is listed in the work stats, so the struct stays put
+//   (with f cleared, so a last queued run does nothing) for the next registration to reuse.
+struct pc_timer {
+    struct periodic_callback pc;
+    struct timer t;
+    struct work w;
+};
+
+static struct pc_timer** pcs = 0;
+static uint64_t len = 0;
 static uint64_t cap = 0;
 
 extern uint64_t int_tick_hz;
 
+static void fire(struct timer* t) {
+    struct pc_timer* cp = (struct pc_timer*) ((uint8_t*) t - __builtin_offsetof(struct pc_timer, t));
+    queueWork(&cp->w, (uint64_t) cp);
+}
+
+static void run(uint64_t ctx) {
+    struct pc_timer* cp = (struct pc_timer*) ctx;
+    if (cp->pc.f)
+        cp->pc.f();
+}
+
 void registerPeriodicCallback(struct periodic_callback c) {
     if (c.count < 1 || c.count > int_tick_hz) {
         logf("WARNING: Skipping adding periodic callback with count: %u\n", c.count);
@@ -25,41 +50,53 @@ void registerPeriodicCallback(struct periodic_callback c) {
 
     no_ints();
 
-    if (!periodicCallbacks.pcs) {
-        cap = INIT_CAP;
-        periodicCallbacks.pcs = malloc(INIT_CAP * sizeof(void*));
-    } else if (periodicCallbacks.len + 1 >= cap) {
-        cap *= 2;
-        periodicCallbacks.pcs = realloc(periodicCallbacks.pcs, cap * sizeof(void*));
+    struct pc_timer* cp = 0;
+    for (uint64_t i = 0; i < len && !cp; i++)
+        if (!pcs[i]->pc.f && !pcs[i]->w.pending)
+            cp = pcs[i];
+
+    if (!cp) {
+        if (!pcs) {
+            cap = INIT_CAP;
+            pcs = malloc(INIT_CAP * sizeof(void*));
+        } else if (len + 1 >= cap) {
+            cap *= 2;
+            pcs = realloc(pcs, cap * sizeof(void*));
+        }
+
+        cp = (struct pc_timer*) mallocz(sizeof(struct pc_timer));
+        pcs[len++] = cp;
+        cp->t.fire = fire;
+        cp->w.fn = run;
+        cp->w.lane = WORK_LOW;
+        cp->w.coalesce = 1;
+    } else {
+        cp->w.runs = cp->w.coalesced = cp->w.dropped = 0;
+        cp->w.delay_ns = cp->w.max_delay_ns = cp->w.run_ns = cp->w.max_run_ns = 0;
     }
 
-    struct periodic_callback* cp = (struct periodic_callback*) malloc(sizeof(struct periodic_callback));
-    cp->count = c.count;
-    cp->period = c.period;
-    cp->f = c.f;
+    cp->pc = c;
+    cp->w.name = c.name ? c.name : "(callback)";
 
-    periodicCallbacks.pcs[periodicCallbacks.len++] = cp;
+    uint64_t every = 1000000000ull * c.period / c.count;
+    if (!timerStart(&cp->t, (clockNs() / every + 1) * every, every))
+        cp->pc.f = 0;
 
     ints_okay();
 }
 
 void unregisterPeriodicCallback(struct periodic_callback c) {
-    if (!periodicCallbacks.pcs) return;
+    if (!pcs) return;
 
     no_ints();
 
-    int found = 0;
-    for (uint64_t i = 0; i < periodicCallbacks.len - 1; i++) {
-        if (found) {
-            periodicCallbacks.pcs[i] = periodicCallbacks.pcs[i+1];
-        } else if (periodicCallbacks.pcs[i]->count == c.count &&
-                   periodicCallbacks.pcs[i]->period == c.period &&
-                   periodicCallbacks.pcs[i]->f == c.f) {
-            found = 1;
+    for (uint64_t i = 0; i < len; i++) {
+        if (pcs[i]->pc.f && pcs[i]->pc.count == c.count && pcs[i]->pc.period == c.period && pcs[i]->pc.f == c.f) {
+            timerStop(&pcs[i]->t);
+            pcs[i]->pc.f = 0;
+            break;
         }
     }
 
-    periodicCallbacks.len--;
-
     ints_okay();
 }
@@ -6,6 +6,7 @@ struct periodic_callback {
     uint64_t count;
     uint64_t period;
     void (*f)();
+    char* name; // For work stats
 };
 
 void registerPeriodicCallback(struct periodic_callback c);
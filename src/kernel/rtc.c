@@ -3,6 +3,7 @@
 #include "rtc.h"
 #include "rtc_int.h"
 
+#include "clock.h"
 #include "interrupt.h"
 #include "io.h"
 
@@ -35,6 +36,7 @@
 #define BCD_OFF (1<<2)
 
 uint64_t ms_since_boot = 0;
+uint64_t epoch_at_boot = 0;
 static uint64_t rtc_seconds, seconds_at_boot;
 
 #define READ(r) outb(REG_SEL, r | NMI_DISABLED); \
@@ -106,7 +108,12 @@ static void sync_rtc_seconds() {
     // Now calculate seconds into day
     rtc_seconds = (t.hours * 60 + t.minutes) * 60 + t.seconds;
 
-    // TODO: Let's also store rest of data.
+    // And days since 1970 (counting years from March, so the leap day is the last day of the year)
+    uint64_t y = (t.century ? t.century : 20) * 100 + t.year - (t.month <= 2);
+    uint64_t m = t.month > 2 ? t.month - 3 : t.month + 9;
+    uint64_t doy = (153 * m + 2) / 5 + t.day_of_month - 1;
+    uint64_t days = y * 365 + y / 4 - y / 100 + y / 400 + doy - 719468;
+    epoch_at_boot = days * 60 * 60 * 24 + rtc_seconds;
 }
 
 // To be called only from IRQ8 handler; assumes interrupts are disabled (doesn't sti at end)
@@ -132,7 +139,8 @@ uint8_t irq8_type() {
 // To be called only when interrupts are safe to enable.
 void get_rtc_time(struct rtc_time* t) {
     // Rather than essentially flooring cmos time, let's estimate that we're in the middle of a second (so add 500 ms)
-    rtc_seconds = (seconds_at_boot + (ms_since_boot + 500) / 1000) % (60 * 60 * 24);
+    uint64_t ms = clockNs() / 1000000;
+    rtc_seconds = (seconds_at_boot + (ms + 500) / 1000) % (60 * 60 * 24);
     // static uint64_t last_sync = 0;
 
     // TODO: I think I may still want this periodically?
@@ -145,7 +153,7 @@ void get_rtc_time(struct rtc_time* t) {
     //     __asm__ __volatile__("sti");
     // }
 
-    t->ms = ms_since_boot % 1000;
+    t->ms = (ms + 500) % 1000;
     t->seconds = rtc_seconds % 60;
     t->minutes = rtc_seconds / 60 % 60;
     t->hours = rtc_seconds / 60 / 60;
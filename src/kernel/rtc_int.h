@@ -6,6 +6,7 @@
 #define RTC_INT_UPDATED 2
 
 extern uint64_t ms_since_boot;
+extern uint64_t epoch_at_boot; // Unix time, to the second, that the RTC said when we booted
 
 void init_rtc();
 uint8_t irq8_type();
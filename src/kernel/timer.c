@@ -0,0 +1,72 @@
+#include <stdint.h>
+
+#include "timer.h"
+
+#include "interrupt.h"
+
+#include "../lib/malloc.h"
+#include "../lib/min_heap.h"
+
+#define timerLess(a, b) ((a)->due_ns < (b)->due_ns)
+#define timerMoved(item, i) ((*(item))->slot = (i) + 1)
+
+DEFINE_MIN_HEAP(timer_heap, struct timer*, timerLess, timerMoved)
+
+static struct timer_heap timers;
+
+uint64_t timerStart(struct timer* t, uint64_t due_ns, uint64_t period_ns) {
+    no_ints();
+
+    if (t->slot)
+        timer_heapRemoveAt(&timers, t->slot - 1);
+
+    t->due_ns = due_ns;
+    t->period_ns = period_ns;
+    t->slot = 0;
+    uint64_t ok = timer_heapPush(&timers, t);
+
+    ints_okay();
+
+    if (ok)
+        rearmTimer();
+
+    return ok;
+}
+
+void timerStop(struct timer* t) {
+    no_ints();
+
+    if (t->slot) {
+        timer_heapRemoveAt(&timers, t->slot - 1);
+        t->slot = 0;
+    }
+
+    ints_okay();
+}
+
+uint64_t timerNext() {
+    struct timer** top = timer_heapPeek(&timers);
+    return top ? (*top)->due_ns : -1ull;
+}
+
+// A periodic timer stays put in the heap and just sifts down to its next deadline, so this never grows it (irq0 can't allocate)
+void runTimers(uint64_t now_ns) {
+    struct timer** top;
+
+    while ((top = timer_heapPeek(&timers)) && (*top)->due_ns <= now_ns) {
+        struct timer* t = *top;
+
+        if (t->period_ns) {
+            // Any it's missed (interrupts were off a long while, say) are skipped rather than fired in a burst
+            t->due_ns += t->period_ns;
+            if (t->due_ns <= now_ns)
+                t->due_ns += ((now_ns - t->due_ns) / t->period_ns + 1) * t->period_ns;
+            timer_heapSiftDown(&timers, 0);
+        } else {
+            timer_heapPop(&timers);
+            t->slot = 0;
+        }
+
+        t->fire(t);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// One-shot and periodic timers on the clock's nanoseconds, in a min-heap by deadline.  irq0 only has to look at the top to know
+//   nothing's due, however many timers there are, and it's the top the one-shot is set for when tickless; each timer that fires
+//   costs a sift.  fire is called from irq0 with interrupts off, so it mustn't allocate or block: waking a process or queueing
+//   work for waitloop is about the extent of it.
+//
+// The struct is the caller's, zeroed before first use (fire set, of course); it's in the heap only while armed.
+
+struct timer {
+    uint64_t due_ns;
+    uint64_t period_ns; // 0 for a one-shot
+    void (*fire)(struct timer* t);
+    uint64_t slot;      // Index in the heap + 1 while armed, else 0
+};
+
+uint64_t timerStart(struct timer* t, uint64_t due_ns, uint64_t period_ns); // (Re)arms it; 0 if out of memory
+void timerStop(struct timer* t);
+uint64_t timerNext(); // Earliest deadline, or -1 if no timers are armed
+void runTimers(uint64_t now_ns);
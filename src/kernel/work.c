@@ -0,0 +1,128 @@
+#include <stdint.h>
+
+#include "work.h"
+
+#include "clock.h"
+#include "interrupt.h"
+#include "log.h"
+
+#include "../lib/spsc_ring.h"
+#include "../lib/syscall.h"
+
+// Each lane is an SPSC ring: interrupt handlers are the one producer (they can't interrupt each other) and waitloop the one
+//   consumer, so neither side needs to turn interrupts off.  The rings never grow (handlers mustn't touch the heap), so
+//   checkWorkQueues says if one's been overflowing.  Kinds of work are listed for stats as they're first queued; past WORK_KINDS
+//   they still run but aren't listed.
+
+#define LANE_ORDER 6 // 64 slots
+#define BATCH 16
+#define WORK_KINDS 32
+
+struct work_item {
+    struct work* w;
+    uint64_t ctx;
+    uint64_t queued_ns;
+};
+
+DEFINE_SPSC_RING(work_ring, struct work_item, LANE_ORDER)
+
+static struct work_ring lanes[WORK_LANES];
+static struct work* kinds[WORK_KINDS];
+static uint64_t kind_count;
+static uint64_t running_queued_ns;
+
+uint64_t queueWork(struct work* w, uint64_t ctx) {
+    if (!w->id && kind_count < WORK_KINDS) {
+        kinds[kind_count++] = w;
+        w->id = kind_count;
+    }
+
+    if (w->coalesce && w->pending) {
+        w->coalesced++;
+        return 0;
+    }
+
+    if (!work_ringPush(&lanes[w->lane], (struct work_item) {w, ctx, clockNs()})) {
+        w->dropped++;
+        return 0;
+    }
+
+    w->pending = 1;
+    return 1;
+}
+
+// Returns how many it ran
+static uint64_t runBatch(struct work_ring* lane) {
+    struct work_item batch[BATCH];
+    uint64_t n = work_ringPopBatch(lane, batch, BATCH);
+
+    for (uint64_t i = 0; i < n; i++) {
+        struct work* w = batch[i].w;
+        // Interrupts are on, so a handler may queue it again between the pop and here; that just counts as coalesced, as it
+        //   hasn't run yet and is about to
+        w->pending = 0;
+
+        uint64_t start = clockNs();
+        running_queued_ns = batch[i].queued_ns;
+        w->fn(batch[i].ctx);
+        running_queued_ns = 0;
+        uint64_t end = clockNs();
+
+        uint64_t delay = start - batch[i].queued_ns, ran = end - start;
+        w->runs++;
+        w->delay_ns += delay;
+        w->run_ns += ran;
+        if (delay > w->max_delay_ns)
+            w->max_delay_ns = delay;
+        if (ran > w->max_run_ns)
+            w->max_run_ns = ran;
+    }
+
+    return n;
+}
+
+void runWork() {
+    while (runBatch(&lanes[WORK_HIGH]) || runBatch(&lanes[WORK_LOW]))
+        ;
+}
+
+uint64_t workQueuedNs() {
+    return running_queued_ns;
+}
+
+uint64_t getWorkStats(struct sc_work_stats* ws, uint64_t max) {
+    for (uint64_t i = 0; i < kind_count && i < max; i++) {
+        struct work* w = kinds[i];
+
+        int j;
+        for (j = 0; w->name[j] && j < SC_WORK_NAME_LEN - 1; j++)
+            ws[i].name[j] = w->name[j];
+        ws[i].name[j] = 0;
+
+        ws[i].lane = w->lane;
+        ws[i].coalesce = w->coalesce;
+        ws[i].runs = w->runs;
+        ws[i].coalesced = w->coalesced;
+        ws[i].dropped = w->dropped;
+        ws[i].delay_ns = w->delay_ns;
+        ws[i].max_delay_ns = w->max_delay_ns;
+        ws[i].run_ns = w->run_ns;
+        ws[i].max_run_ns = w->max_run_ns;
+    }
+
+    return kind_count;
+}
+
+// Rings can't grow from a handler, so instead say something if one's been overflowing (and how full it's got), to size it better
+void checkWorkQueues() {
+    static uint64_t overflows[WORK_LANES];
+    static char* names[WORK_LANES] = {"high", "low"};
+
+    for (uint64_t i = 0; i < WORK_LANES; i++) {
+        if (lanes[i].overflows != overflows[i]) {
+            logf("WARNING: %s-priority work lane dropped %u items (of %u slots, high water %u)\n", names[i],
+                 lanes[i].overflows - overflows[i], 1ull << LANE_ORDER, lanes[i].high_water);
+            overflows[i] = lanes[i].overflows;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+struct sc_work_stats;
+
+// Work that interrupt handlers leave for waitloop, which turns interrupts on and runs it before picking a process.  A struct work is a
+//   kind of item: the function, the lane it goes in, whether it coalesces, and its stats.  Each queueing carries a context word
+//   for the function (a scancode, say), so nothing needs a queue of its own.  waitloop empties the high lane before each batch
+//   from the low one, so a keypress never waits behind a backlog of log flushes.
+//
+// A coalescing item is queued at most once at a time: queueing it while it's still pending does nothing (its ctx included), so a
+//   waitloop that's fallen behind runs, say, the console clock's update once rather than once for every time it came due.  It's
+//   no longer pending once it starts running, so anything that queues it during the run gets another.
+
+#define WORK_HIGH 0
+#define WORK_LOW 1
+#define WORK_LANES 2
+
+struct work {
+    char* name;
+    void (*fn)(uint64_t ctx);
+    uint8_t lane;
+    uint8_t coalesce;
+
+    uint8_t pending;
+    uint8_t id; // Its slot in the stats table, + 1; 0 until first queued
+
+    uint64_t runs;
+    uint64_t coalesced;   // Times queueing it did nothing, as it was already pending
+    uint64_t dropped;     // Times its lane was full
+    uint64_t delay_ns;    // Total time from queued to started
+    uint64_t max_delay_ns;
+    uint64_t run_ns;      // Total time running
+    uint64_t max_run_ns;
+};
+
+uint64_t queueWork(struct work* w, uint64_t ctx); // From interrupt handlers, or with interrupts off; 0 if coalesced or dropped
+void runWork(); // waitloop: until both lanes are empty
+uint64_t workQueuedNs(); // When the item that's running was queued (0 if none is), for wakeup latency
+uint64_t getWorkStats(struct sc_work_stats* ws, uint64_t max); // Fills in up to max; returns how many kinds there are
+void checkWorkQueues();
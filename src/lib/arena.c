@@ -0,0 +1,228 @@
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#include "malloc.h"
+#include "mem.h"
+#include "strings.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK 4096 // Smallest chunk we'll malloc, header included
+
+struct arena_chunk {
+    struct arena_chunk* prev;
+    uint8_t* end;
+    uint64_t owned; // 0 for the caller's initial buffer
+};
+
+#define align_up(p) ((uint8_t*) (((uint64_t) (p) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1ull)))
+#define chunk_data(c) align_up((uint8_t*) (c) + sizeof(struct arena_chunk))
+#define chunk_size(c) ((uint64_t) ((c)->end - chunk_data(c)))
+
+void initArena(struct arena* a, void* buf, uint64_t size) {
+    a->chunk = 0;
+    a->spare = 0;
+    a->pos = 0;
+    a->end = 0;
+    a->grows = 0;
+
+    struct arena_chunk* c = (struct arena_chunk*) align_up(buf);
+    if (!buf || (uint8_t*) c + sizeof(struct arena_chunk) + ARENA_ALIGN > (uint8_t*) buf + size)
+        return;
+
+    c->prev = 0;
+    c->end = (uint8_t*) buf + size;
+    c->owned = 0;
+
+    a->chunk = c;
+    a->pos = chunk_data(c);
+    a->end = c->end;
+}
+
+static int grow(struct arena* a, uint64_t n) {
+    struct arena_chunk* c = a->spare;
+
+    if (c && chunk_size(c) >= n) {
+        a->spare = 0;
+    } else {
+        uint64_t size = sizeof(struct arena_chunk) + ARENA_ALIGN + n;
+        if (size < ARENA_CHUNK)
+            size = ARENA_CHUNK;
+
+        c = malloc(size);
+        if (!c)
+            return 0;
+
+        c->end = (uint8_t*) c + size;
+        c->owned = 1;
+        a->grows++;
+    }
+
+    c->prev = a->chunk;
+    a->chunk = c;
+    a->pos = chunk_data(c);
+    a->end = c->end;
+
+    return 1;
+}
+
+void* arenaAlloc(struct arena* a, uint64_t n) {
+    uint8_t* p = align_up(a->pos);
+
+    if (!a->chunk || p > a->end || n > (uint64_t) (a->end - p)) {
+        if (!grow(a, n))
+            return 0;
+        p = a->pos;
+    }
+
+    a->pos = p + n;
+
+    return p;
+}
+
+void* arenaRealloc(struct arena* a, void* p, uint64_t old_n, uint64_t new_n) {
+    if (p && (uint8_t*) p + old_n == a->pos && new_n <= (uint64_t) (a->end - (uint8_t*) p)) {
+        a->pos = (uint8_t*) p + new_n;
+        return p;
+    }
+
+    if (p && new_n <= old_n)
+        return p;
+
+    void* q = arenaAlloc(a, new_n);
+    if (q && p)
+        memcpy(q, p, old_n);
+
+    return q;
+}
+
+struct arena_mark arenaMark(struct arena* a) {
+    struct arena_mark m = {a->chunk, a->pos};
+    return m;
+}
+
+// Keeps the biggest chunk we let go of, so the next grow (very likely the same size as this one was) needn't malloc
+static void drop(struct arena* a, struct arena_chunk* c) {
+    if (!c->owned)
+        return;
+
+    if (a->spare && chunk_size(a->spare) >= chunk_size(c)) {
+        free(c);
+    } else {
+        if (a->spare)
+            free(a->spare);
+        a->spare = c;
+    }
+}
+
+void arenaReset(struct arena* a, struct arena_mark m) {
+    while (a->chunk && a->chunk != m.chunk) {
+        struct arena_chunk* c = a->chunk;
+        a->chunk = c->prev;
+        drop(a, c);
+    }
+
+    a->pos = m.pos;
+    a->end = a->chunk ? a->chunk->end : 0;
+}
+
+void freeArena(struct arena* a) {
+    while (a->chunk) {
+        struct arena_chunk* c = a->chunk;
+        a->chunk = c->prev;
+        if (c->owned)
+            free(c);
+    }
+
+    if (a->spare)
+        free(a->spare);
+
+    initArena(a, 0, 0);
+}
+
+void sbInit(struct sbuf* b, char* buf, uint64_t cap) {
+    b->s = buf;
+    b->len = 0;
+    b->cap = buf ? cap : 0;
+    b->a = 0;
+    b->truncated = 0;
+
+    if (b->cap)
+        b->s[0] = 0;
+}
+
+void sbInitArena(struct sbuf* b, struct arena* a, uint64_t cap) {
+    if (cap < ARENA_ALIGN)
+        cap = ARENA_ALIGN;
+
+    sbInit(b, arenaAlloc(a, cap), cap);
+    b->a = a;
+}
+
+// Makes room for n more chars if we can, returning how many of them will fit
+static uint64_t room(struct sbuf* b, uint64_t n) {
+    if (b->len + n + 1 > b->cap && b->a) {
+        uint64_t cap = b->cap * 2;
+        if (cap < b->len + n + 1)
+            cap = b->len + n + 1;
+
+        char* s = arenaRealloc(b->a, b->s, b->cap, cap);
+        if (s) {
+            b->s = s;
+            b->cap = cap;
+        }
+    }
+
+    uint64_t left = b->cap ? b->cap - 1 - b->len : 0;
+    if (n > left) {
+        b->truncated = 1;
+        return left;
+    }
+
+    return n;
+}
+
+void sbAppendN(struct sbuf* b, char* t, uint64_t n) {
+    n = room(b, n);
+    if (!b->cap)
+        return;
+
+    memcpy(b->s + b->len, t, n);
+    b->len += n;
+    b->s[b->len] = 0;
+}
+
+void sbAppend(struct sbuf* b, char* t) {
+    sbAppendN(b, t, strlen(t));
+}
+
+void sbAppendChar(struct sbuf* b, char c) {
+    sbAppendN(b, &c, 1);
+}
+
+void sbVprintf(struct sbuf* b, char* fmt, va_list ap) {
+    uint64_t left = b->cap - b->len; // Includes the NUL's spot; 0 only if there's no buffer at all
+    char* at = left ? b->s + b->len : 0;
+
+    va_list ap2;
+    va_copy(ap2, ap);
+    uint64_t n = vformat(at, left, fmt, ap2);
+    va_end(ap2);
+
+    if (n >= left) {
+        uint64_t fits = room(b, n);
+        if (fits == n)
+            vformat(b->s + b->len, b->cap - b->len, fmt, ap);
+        n = fits;
+    }
+
+    b->len += n;
+}
+
+void sbPrintf(struct sbuf* b, char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    sbVprintf(b, fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+
+// Bump allocator for temporaries: allocating is a pointer bump, and nothing is freed individually -- take a mark before a burst of
+//   work and reset to it afterward, and everything allocated in between goes at once.  An arena can start out on a caller's buffer
+//   (static, or on the stack); when that's full it grows by malloc'ing chunks, and a reset keeps the largest chunk it drops as a
+//   spare, so an arena that's reset around each request settles down to never touching the heap.  A zeroed arena is a valid
+//   empty one.  Nothing here disables interrupts, so an arena should belong to one context (or be used with them off).
+
+struct arena_chunk;
+
+struct arena {
+    struct arena_chunk* chunk; // Current chunk (0 until the first allocation if there's no initial buffer)
+    struct arena_chunk* spare;
+    uint8_t* pos;
+    uint8_t* end;
+    uint64_t grows; // Chunks malloc'd (a steadily growing count means the initial buffer is too small for the work)
+};
+
+struct arena_mark {
+    struct arena_chunk* chunk;
+    uint8_t* pos;
+};
+
+void initArena(struct arena* a, void* buf, uint64_t size);
+void* arenaAlloc(struct arena* a, uint64_t n);
+void* arenaRealloc(struct arena* a, void* p, uint64_t old_n, uint64_t new_n); // Extends in place if p was the last allocation
+struct arena_mark arenaMark(struct arena* a);
+void arenaReset(struct arena* a, struct arena_mark m);
+void freeArena(struct arena* a); // Frees every chunk it malloc'd; the arena is then empty (and no longer uses its initial buffer)
+
+// String builder.  Over an arena it grows as needed; over a fixed buffer it stops at the end (and notes that it did), so the
+//   same code can build into the stack or into scratch memory.  s is always NUL-terminated.
+
+struct sbuf {
+    char* s;
+    uint64_t len;
+    uint64_t cap;
+    struct arena* a; // 0 for a fixed buffer
+    uint8_t truncated;
+};
+
+void sbInit(struct sbuf* b, char* buf, uint64_t cap);
+void sbInitArena(struct sbuf* b, struct arena* a, uint64_t cap);
+void sbAppend(struct sbuf* b, char* t);
+void sbAppendN(struct sbuf* b, char* t, uint64_t n);
+void sbAppendChar(struct sbuf* b, char c);
+void sbPrintf(struct sbuf* b, char* fmt, ...);
+void sbVprintf(struct sbuf* b, char* fmt, va_list ap);
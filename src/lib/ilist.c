@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include "ilist.h"
+
+// A zeroed struct ilist is an empty list and a zeroed node is unlinked, so both can just sit in static or mallocz'd memory.
+
+void pushIListHead(struct ilist* l, struct ilist_node* n) {
+    n->list = l;
+    n->next = l->head;
+    n->prev = 0;
+
+    if (l->head)
+        l->head->prev = n;
+    else
+        l->tail = n;
+
+    l->head = n;
+    l->len++;
+}
+
+void pushIListTail(struct ilist* l, struct ilist_node* n) {
+    n->list = l;
+    n->next = 0;
+    n->prev = l->tail;
+
+    if (l->tail)
+        l->tail->next = n;
+    else
+        l->head = n;
+
+    l->tail = n;
+    l->len++;
+}
+
+// Unlinking a node that isn't on a list is fine and does nothing, so callers needn't track that themselves.
+void removeFromIList(struct ilist_node* n) {
+    struct ilist* l = n->list;
+    if (!l) return;
+
+    if (n->prev)
+        n->prev->next = n->next;
+    else
+        l->head = n->next;
+
+    if (n->next)
+        n->next->prev = n->prev;
+    else
+        l->tail = n->prev;
+
+    n->next = n->prev = 0;
+    n->list = 0;
+    l->len--;
+}
+
+struct ilist_node* popIListHead(struct ilist* l) {
+    struct ilist_node* n = l->head;
+    if (n)
+        removeFromIList(n);
+
+    return n;
+}
+
+// Next node, wrapping from tail back to head; 0 only if n isn't on a list
+struct ilist_node* nextINodeCirc(struct ilist_node* n) {
+    if (!n || !n->list) return 0;
+
+    return n->next ? n->next : n->list->head;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Intrusive list: the link lives inside the item (say, a `struct ilist_node run_node;' in struct process), so pushing and
+//   removing never allocate, and removal is O(1) given just the item.  An item can be on as many lists as it has links, but each
+//   link is on at most one list at a time; node->list says which (0 if none).
+
+struct ilist;
+
+struct ilist_node {
+    struct ilist_node* next;
+    struct ilist_node* prev;
+    struct ilist* list;
+};
+
+struct ilist {
+    struct ilist_node* head;
+    struct ilist_node* tail;
+    uint64_t len;
+};
+
+// Item containing node n, where n is the item's member named `member' (0 stays 0)
+#define iListItem(n, type, member) ({                                              \
+    struct ilist_node* __n__ = (n);                                                \
+    __n__ ? (type*) ((uint8_t*) __n__ - __builtin_offsetof(type, member)) : (type*) 0; \
+})
+
+// Loops over nodes, or items, of l; the _safe versions let the body unlink the current one
+#define iListForEach(n, l) for (struct ilist_node* n = (l)->head; n; n = n->next)
+#define iListForEachSafe(n, l) \
+    for (struct ilist_node* n = (l)->head, *__next__ = n ? n->next : 0; n; n = __next__, __next__ = n ? n->next : 0)
+#define iListForEachItem(p, l, type, member) \
+    for (type* p = iListItem((l)->head, type, member); p; p = iListItem(p->member.next, type, member))
+
+void pushIListHead(struct ilist* l, struct ilist_node* n);
+void pushIListTail(struct ilist* l, struct ilist_node* n);
+struct ilist_node* popIListHead(struct ilist* l);
+void removeFromIList(struct ilist_node* n);
+struct ilist_node* nextINodeCirc(struct ilist_node* n);
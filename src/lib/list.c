@@ -141,6 +141,7 @@ void removeNodeFromList(struct list* l, void* ln) {
     if (n == l->tail)
         l->tail = n->prev;
 
+    l->len--;
     free(n);
 
     return;
@@ -149,10 +150,11 @@ void removeNodeFromList(struct list* l, void* ln) {
 void removeFromListWithEquality(struct list* l, int (*equals)(void*)) {
     if (!l || !l->head) return;
 
-    l->len--;
-    for (struct list_node* cur = l->head; cur; cur = cur->next)
+    for (struct list_node* cur = l->head, *next; cur; cur = next) {
+        next = cur->next;
         if (equals(cur->item))
             removeNodeFromList(l, cur);
+    }
 }
 
 void* getNodeByCondition(struct list* l, int (*matches)(void*)) {
@@ -167,13 +169,13 @@ void* getNodeByCondition(struct list* l, int (*matches)(void*)) {
 
 // Removes first occurance of item from list, if it exists
 void removeFromList(struct list* l, void* item) {
-    removeFromListWithEquality(l, ({
-        int __fn__ (void* other) {
-            return other == item;
-        }
+    if (!l) return;
 
-        __fn__;
-    }));
+    for (struct list_node* cur = l->head; cur; cur = cur->next)
+        if (cur->item == item) {
+            removeNodeFromList(l, cur);
+            return;
+        }
 }
 
 static void* forEachLI(struct list_node* n, void (*f)(void*)) {
@@ -2,7 +2,10 @@
 
 #include "malloc.h"
 
+#include "mem.h"
+
 #ifdef KERNEL
+#include "../kernel/alloc_profile.h"
 #include "../kernel/interrupt.h"
 #endif
 
@@ -11,12 +14,15 @@
 #define BLK_SZ 128
 #define MAP_ENTRY_SZ 2
 #define QBLK_SZ (64 / MAP_ENTRY_SZ * BLK_SZ)
-#define L2_PAGE_SZ (2ull * 1024 * 1024)
 #define heap64 ((uint64_t) heap)
 
 #define BFREE 0b00ull
 #define BPART 0b11ull
 #define BEND  0b10ull
+#define BSLAB 0b01ull // Block is part of a slab (always a whole map qword's worth at once)
+
+#define ENTRIES_PER_QWORD (64 / MAP_ENTRY_SZ)
+#define ENTRY_LOW_BITS 0x5555555555555555ull
 
 #define blocks_per(region_sz, block_sz) ((region_sz / block_sz) + !!(region_sz % block_sz))
 
@@ -34,212 +40,739 @@ static uint64_t map_size; // Size in quadwords
 static uint64_t* map = (uint64_t*) 0;
 static uint64_t* heap = (uint64_t*) 0;
 
-// `size' is the number of bytes available to us for (map + heap)
-// I think I want to 4096-align (0x1000) heap start, to make pages page aligned, to make palloc a bit easier
-//   (so l2 2MB page alignment will be a whole number of our pages...)
-void init_heap(uint64_t* start, uint64_t size) {
-    map_size = size / (QBLK_SZ / 8 + 1) / 8;
-    map = start;
-    for (uint64_t i = 0; i < map_size; i++)
-        map[i] = 0;
-    heap = map + map_size;
-    #ifdef KERNEL
-    if (heap64 % 0x1000)
-        heap = (void*) ((heap64 + 0x1000) & ~0xfffull);
-    #endif
+/*
+  Small allocations come from slabs rather than the map directly.  A slab is the QBLK_SZ of heap covered by exactly one map
+    qword, so finding a slab's header from an object is just rounding down, and telling a slab object from a regular allocation
+    is just looking at the object's map entry.  Each size class keeps a list of slabs that have room; allocating pops a freed
+    object (or bumps into never-used space), and freeing pushes it back, so neither depends on how full the heap is.
+*/
+
+#define SLAB_MIN_SHIFT 4 // 16 bytes
+#define SLAB_CLASSES 6   // 16, 32, 64, 128, 256, 512
+#define SLAB_MAX_OBJ (1ull << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1))
+#define SLAB_MAP_ENTRY 0x5555555555555555ull // Every entry BSLAB
+
+struct slab {
+    struct slab* next; // Links in partial list for this size class (only valid while slab has room)
+    struct slab* prev;
+    void* free;        // Singly-linked list of freed objects, link stored in the object itself
+    uint32_t bump;     // Offset of first never-allocated object
+    uint32_t inuse;
+    uint32_t cls;
+};
+
+static struct slab* partial[SLAB_CLASSES];
+
+#define slab_obj_sz(cls) (1ull << ((cls) + SLAB_MIN_SHIFT))
+#define slab_first_obj(cls) (blocks_per(sizeof(struct slab), slab_obj_sz(cls)) * slab_obj_sz(cls))
+#define slab_cap(cls) ((QBLK_SZ - slab_first_obj(cls)) / slab_obj_sz(cls))
+
+/*
+  Searching `map' itself is linear in heap size, and we do it with interrupts off, so we keep a summary of it to search instead.
+  It's a tree with FANOUT children per node; the leaves are the map qwords themselves (plus `qbest', the longest free run in
+    each, since that one isn't a couple of instructions to work out).  Each node knows how many free blocks its span starts and
+    ends with and the longest free run anywhere in it, which is enough to find the first fit for any size by looking at one node's
+    children per level.  It also counts entirely free map qwords, for slabs.
+
+  Nodes past the end of the map, and leaves past the end of the map, are treated as fully used.
+*/
+
+#define FANOUT 64
+#define FANOUT_SHIFT 6
+#define MAX_LEVELS 6
+#define span(level) ((uint64_t) ENTRIES_PER_QWORD << (FANOUT_SHIFT * (level)))
+
+struct summary {
+    uint32_t pre;   // Free blocks at start of span
+    uint32_t suf;   // Free blocks at end of span
+    uint32_t best;  // Longest free run anywhere in span
+    uint32_t nfree; // Map qwords in span that are entirely free
+};
+
+static uint8_t* qbest = (uint8_t*) 0;
+static struct summary* levels[MAX_LEVELS + 1]; // levels[0] is unused; the leaves are map and qbest
+static uint64_t level_len[MAX_LEVELS + 1];
+static uint64_t top_level;
+
+#define root (&levels[top_level][0])
+
+/*
+  Live accounting, kept up to date by everything that changes the map, so that asking how the heap is doing doesn't mean reading
+    the whole map.  Along with used/peak/allocation counts we keep a histogram of free runs by size (bucket n counts runs of
+    [2^n, 2^(n+1)) blocks); whenever blocks change hands we look up the free runs on either side of them (the summary tree
+    lets us skip over big free stretches) and move the affected runs between buckets.
+*/
+
+static uint64_t used_blocks, peak_blocks, live_allocs, total_allocs;
+static uint64_t reallocs_in_place, reallocs_moved, realloc_copied;
+static uint64_t free_runs[HEAP_RUN_BUCKETS];
+
+// Bit 2n is set for each free entry n
+static inline uint64_t free_entries(uint64_t q) {
+    return ~(q | q >> 1) & ENTRY_LOW_BITS;
 }
 
-uint64_t heapUsed() {
-    uint64_t p = 0;
-    for (uint64_t i = 0; i < map_size; i++) {
-        uint64_t entry = map[i];
+static inline uint64_t longest_run(uint64_t f) {
+    uint64_t n = 0;
+    for (; f; n++)
+        f &= f >> MAP_ENTRY_SZ;
 
-        if (entry == 0) continue;
+    return n;
+}
 
-        for (uint64_t j = 0; j < (64 / MAP_ENTRY_SZ); j++, entry >>= MAP_ENTRY_SZ)
-            if (entry & 0b11)
-                p++;
+static inline void child_summary(uint64_t level, uint64_t i, struct summary* c) {
+    if (level == 0) {
+        if (i >= map_size) {
+            *c = (struct summary) {};
+            return;
+        }
+
+        uint64_t used = ~free_entries(map[i]) & ENTRY_LOW_BITS;
+        if (!used) {
+            *c = (struct summary) {ENTRIES_PER_QWORD, ENTRIES_PER_QWORD, ENTRIES_PER_QWORD, 1};
+            return;
+        }
+
+        c->pre = __builtin_ctzll(used) / MAP_ENTRY_SZ;
+        c->suf = ENTRIES_PER_QWORD - 1 - (63 - __builtin_clzll(used)) / MAP_ENTRY_SZ;
+        c->best = qbest[i];
+        c->nfree = 0;
+
+        return;
     }
 
-    return p * BLK_SZ;
+    if (i >= level_len[level])
+        *c = (struct summary) {};
+    else
+        *c = levels[level][i];
 }
 
-// Number of bytes in the actual heap (not counting map of heap as part of heap)
-uint64_t heapSize() {
-    return map_size * QBLK_SZ;
-}
+// Returns whether the node's summary changed
+static int summarize(uint64_t level, uint64_t i) {
+    uint64_t cs = span(level - 1);
+    uint64_t pre = 0, cur = 0, best = 0, nfree = 0;
+    int leading = 1;
+    struct summary c;
+
+    for (uint64_t j = 0; j < FANOUT; j++) {
+        child_summary(level - 1, i * FANOUT + j, &c);
+
+        if (c.pre == cs) {
+            cur += cs;
+            if (leading)
+                pre += cs;
+        } else {
+            if (leading) {
+                pre += c.pre;
+                leading = 0;
+            }
 
-void* malloc(uint64_t nBytes) {
-    if (heap == 0 || nBytes == 0)
+            if (cur + c.pre > best)
+                best = cur + c.pre;
+            if (c.best > best)
+                best = c.best;
+
+            cur = c.suf;
+        }
+
+        nfree += c.nfree;
+    }
+
+    if (cur > best)
+        best = cur;
+
+    struct summary* n = &levels[level][i];
+    if (n->pre == pre && n->suf == cur && n->best == best && n->nfree == nfree)
         return 0;
 
-    uint64_t needed = blocks_per(nBytes, BLK_SZ);
-    uint64_t mask = 0;
+    *n = (struct summary) {pre, cur, best, nfree};
+    return 1;
+}
 
-    for (uint64_t i = 0; i < needed && mask != -1ull; i++)
-        mask = (mask << 2) + 0b11;
+// Call after changing map qwords first through last (inclusive); interrupts should be off
+static void update_summary(uint64_t first, uint64_t last) {
+    for (uint64_t i = first; i <= last; i++)
+        qbest[i] = longest_run(free_entries(map[i]));
 
-    uint64_t need;
-    void* ret = 0;
+    int changed = 1;
+    for (uint64_t l = 1; l <= top_level && changed; l++) { // Nothing above an unchanged level can have changed
+        first >>= FANOUT_SHIFT;
+        last >>= FANOUT_SHIFT;
 
-    NO_INTS;
+        changed = 0;
+        for (uint64_t i = first; i <= last; i++)
+            changed |= summarize(l, i);
+    }
+}
+
+// Entries lo through hi (inclusive) of a map qword
+static inline uint64_t entry_mask(uint64_t lo, uint64_t hi) {
+    uint64_t top = hi == ENTRIES_PER_QWORD - 1 ? -1ull : (1ull << ((hi + 1) * MAP_ENTRY_SZ)) - 1;
+    return top & ~((1ull << (lo * MAP_ENTRY_SZ)) - 1);
+}
+
+// Marks n blocks starting at block b as a single allocation
+static void mark_blocks(uint64_t b, uint64_t n) {
+    uint64_t e = b + n - 1;
+
+    for (uint64_t q = b / ENTRIES_PER_QWORD; q <= e / ENTRIES_PER_QWORD; q++) {
+        uint64_t lo = q == b / ENTRIES_PER_QWORD ? b % ENTRIES_PER_QWORD : 0;
+        uint64_t hi = q == e / ENTRIES_PER_QWORD ? e % ENTRIES_PER_QWORD : ENTRIES_PER_QWORD - 1;
+        map[q] |= entry_mask(lo, hi);
+    }
+
+    map[e / ENTRIES_PER_QWORD] &= ~(1ull << (e % ENTRIES_PER_QWORD * MAP_ENTRY_SZ)); // BPART -> BEND
+}
+
+static void clear_blocks(uint64_t b, uint64_t n) {
+    uint64_t e = b + n - 1;
+
+    for (uint64_t q = b / ENTRIES_PER_QWORD; q <= e / ENTRIES_PER_QWORD; q++) {
+        uint64_t lo = q == b / ENTRIES_PER_QWORD ? b % ENTRIES_PER_QWORD : 0;
+        uint64_t hi = q == e / ENTRIES_PER_QWORD ? e % ENTRIES_PER_QWORD : ENTRIES_PER_QWORD - 1;
+        map[q] &= ~entry_mask(lo, hi);
+    }
+}
+
+// Index of the BEND block of the allocation starting at block b
+static uint64_t alloc_end(uint64_t b) {
+    uint64_t q = b / ENTRIES_PER_QWORD;
+    uint64_t ends = (map[q] >> 1) & ~map[q] & ENTRY_LOW_BITS & (-1ull << (b % ENTRIES_PER_QWORD * MAP_ENTRY_SZ));
+
+    while (!ends && q + 1 < map_size) {
+        q++;
+        ends = (map[q] >> 1) & ~map[q] & ENTRY_LOW_BITS;
+    }
+
+    if (!ends) // Corrupt map (or bogus pointer); treat it as running to the end of the heap
+        return map_size * ENTRIES_PER_QWORD - 1;
+
+    return q * ENTRIES_PER_QWORD + __builtin_ctzll(ends) / MAP_ENTRY_SZ;
+}
+
+// Number of free blocks starting at block b
+static uint64_t free_after(uint64_t b) {
+    uint64_t n = 0;
+    struct summary c;
+
+    while (b < map_size * ENTRIES_PER_QWORD) {
+        uint64_t o = b % ENTRIES_PER_QWORD;
+        if (o) {
+            uint64_t used = ~free_entries(map[b / ENTRIES_PER_QWORD]) & ENTRY_LOW_BITS & (-1ull << (o * MAP_ENTRY_SZ));
+            uint64_t run = (used ? __builtin_ctzll(used) / MAP_ENTRY_SZ : ENTRIES_PER_QWORD) - o;
+            n += run;
+            b += run;
+            if (used)
+                break;
+
+            continue;
+        }
 
-    for (uint64_t i = 0; i < map_size; i++) {
-        for (need = needed; need > 64 / MAP_ENTRY_SZ; i++) {
-            if (map[i])
-                goto not_found;
+        // Take as big a step as we can: the largest node starting at b
+        uint64_t l = top_level;
+        while (b % span(l))
+            l--;
 
-            if (!ret)
-                ret = (void*) heap + i * QBLK_SZ;
+        child_summary(l, b / span(l), &c);
+        n += c.pre;
+        b += c.pre;
+        if (c.pre < span(l))
+            break;
+    }
+
+    return n;
+}
 
-            need -= 64 / MAP_ENTRY_SZ;
+// Number of free blocks immediately before block e
+static uint64_t free_before(uint64_t e) {
+    uint64_t n = 0;
+    struct summary c;
+
+    while (e > 0) {
+        uint64_t o = e % ENTRIES_PER_QWORD;
+        if (o) {
+            uint64_t used = ~free_entries(map[e / ENTRIES_PER_QWORD]) & ENTRY_LOW_BITS & entry_mask(0, o - 1);
+            uint64_t run = used ? o - 1 - (63 - __builtin_clzll(used)) / MAP_ENTRY_SZ : o;
+            n += run;
+            e -= run;
+            if (used)
+                break;
+
+            continue;
         }
 
-        mask = 0;
-        for (uint64_t j = 0; j < need; j++)
-            mask = (mask << 2) + 0b11;
+        uint64_t l = top_level;
+        while (e % span(l))
+            l--;
 
-        for (uint64_t j = 0; j < 64 / MAP_ENTRY_SZ - (need - 1); j++, mask <<= 2) {
-            if (!(map[i] & mask)) {
-                mask ^= 1ull << ((need - 1 + j) * 2);
+        child_summary(l, e / span(l) - 1, &c);
+        n += c.suf;
+        e -= c.suf;
+        if (c.suf < span(l))
+            break;
+    }
 
-                if (!ret)
-                    ret = (void*) heap + (i * (64 / MAP_ENTRY_SZ) + j) * BLK_SZ;
+    return n;
+}
 
-                map[i] |= mask;
-                for (; needed > 64 / MAP_ENTRY_SZ; needed -= 64 / MAP_ENTRY_SZ, i--)
-                    map[i-1] = -1ull;
+static inline void count_run(uint64_t len, int d) {
+    if (len)
+        free_runs[63 - __builtin_clzll(len)] += d;
+}
 
-                INTS_OKAY;
-                return ret;
-            } else if (needed > 64 / MAP_ENTRY_SZ) {
-                goto not_found;
-            }
+// Call before marking the n free blocks at b as used
+static void count_taken(uint64_t b, uint64_t n) {
+    uint64_t before = free_before(b), after = free_after(b + n);
+
+    count_run(before + n + after, -1);
+    count_run(before, 1);
+    count_run(after, 1);
+
+    used_blocks += n;
+    if (used_blocks > peak_blocks)
+        peak_blocks = used_blocks;
+}
+
+// Call after clearing the n blocks at b and updating the summary
+static void count_released(uint64_t b, uint64_t n) {
+    uint64_t before = free_before(b), after = free_after(b + n);
+
+    count_run(before, -1);
+    count_run(after, -1);
+    count_run(before + n + after, 1);
+
+    used_blocks -= n;
+}
+
+// First block of the first run of at least n free blocks, or -1
+static uint64_t find_blocks(uint64_t n) {
+    if (root->best < n)
+        return -1ull;
+
+    uint64_t i = 0;
+    struct summary c;
+
+    for (uint64_t l = top_level; l > 0; l--) {
+        uint64_t cs = span(l - 1);
+        uint64_t cur = 0;
+        uint64_t j;
+
+        for (j = 0; j < FANOUT; j++) {
+            child_summary(l - 1, i * FANOUT + j, &c);
+
+            if (cur + c.pre >= n)
+                return (i * FANOUT + j) * cs - cur;
+
+            if (c.best >= n)
+                break;
+
+            cur = c.pre == cs ? cur + cs : c.suf;
         }
 
-    not_found:
-        need = needed;
-        ret = 0;
+        if (j == FANOUT) // Summary is out of sync with map; shouldn't happen
+            return -1ull;
+
+        i = i * FANOUT + j;
+    }
+
+    // Run lies entirely inside map qword i
+    uint64_t f = free_entries(map[i]);
+    for (uint64_t k = 1; k < n; k++)
+        f &= f >> MAP_ENTRY_SZ;
+
+    return i * ENTRIES_PER_QWORD + __builtin_ctzll(f) / MAP_ENTRY_SZ;
+}
+
+// First entirely free map qword, or -1
+static uint64_t find_free_qword() {
+    if (!root->nfree)
+        return -1ull;
+
+    uint64_t i = 0;
+    for (uint64_t l = top_level; l > 1; l--) {
+        uint64_t j = 0;
+        while (levels[l - 1][i * FANOUT + j].nfree == 0)
+            j++;
+
+        i = i * FANOUT + j;
+    }
+
+    for (i *= FANOUT; map[i]; i++)
+        ;
+
+    return i;
+}
+
+// Bytes needed ahead of the heap for map, qbest, and summary levels, for a map of ms qwords
+static uint64_t meta_size(uint64_t ms) {
+    uint64_t sz = ms * sizeof(uint64_t) + blocks_per(ms, 8) * 8;
+
+    for (uint64_t l = 1, n = ms; l == 1 || n > 1; l++) {
+        n = blocks_per(n, FANOUT);
+        sz += n * sizeof(struct summary);
+    }
+
+    return blocks_per(sz, 8) * 8;
+}
+
+#define HEAP_ALIGN QBLK_SZ // So slabs are whole pages
+
+// `size' is the number of bytes available to us for (map + summary + heap)
+void init_heap(uint64_t* start, uint64_t size) {
+    map_size = size / (QBLK_SZ + sizeof(uint64_t) + 1);
+    for (uint64_t over; map_size && meta_size(map_size) + HEAP_ALIGN + map_size * QBLK_SZ > size;) {
+        over = meta_size(map_size) + HEAP_ALIGN + map_size * QBLK_SZ - size;
+        map_size -= blocks_per(over, QBLK_SZ);
+    }
+
+    map = start;
+    memset(map, 0, map_size * sizeof(uint64_t));
+    for (uint64_t i = 0; i < SLAB_CLASSES; i++)
+        partial[i] = 0;
+
+    used_blocks = peak_blocks = live_allocs = total_allocs = 0;
+    reallocs_in_place = reallocs_moved = realloc_copied = 0;
+    for (uint64_t i = 0; i < HEAP_RUN_BUCKETS; i++)
+        free_runs[i] = 0;
+    count_run(map_size * ENTRIES_PER_QWORD, 1);
+
+    qbest = (uint8_t*) (map + map_size);
+    for (uint64_t i = 0; i < map_size; i++)
+        qbest[i] = ENTRIES_PER_QWORD;
+
+    struct summary* s = (struct summary*) (map + map_size + blocks_per(map_size, 8));
+    uint64_t n = map_size;
+    for (top_level = 1; top_level == 1 || n > 1; top_level++) {
+        n = blocks_per(n, FANOUT);
+        levels[top_level] = s;
+        level_len[top_level] = n;
+        s += n;
+
+        for (uint64_t i = 0; i < n; i++) {
+            levels[top_level][i] = (struct summary) {-1, -1, -1, -1}; // Make sure it counts as changed
+            summarize(top_level, i);
+        }
     }
+    top_level--;
+
+    heap = (uint64_t*) (((uint64_t) s + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1));
+}
+
+// Slabs count as used in their entirety, since nothing else can have that space while they're around
+uint64_t heapUsed() {
+    return used_blocks * BLK_SZ;
+}
+
+// Number of bytes in the actual heap (not counting map of heap as part of heap)
+uint64_t heapSize() {
+    return map_size * QBLK_SZ;
+}
+
+void getHeapStats(struct heap_stats* s) {
+    NO_INTS;
+
+    s->size = heapSize();
+    s->used = used_blocks * BLK_SZ;
+    s->peak = peak_blocks * BLK_SZ;
+    s->allocs = live_allocs;
+    s->total_allocs = total_allocs;
+    s->block_size = BLK_SZ;
+    s->largest_free = heap ? root->best * BLK_SZ : 0;
+    s->reallocs_in_place = reallocs_in_place;
+    s->reallocs_moved = reallocs_moved;
+    s->realloc_copied = realloc_copied;
+
+    // How much of the free space is out of reach of an allocation as big as the largest free run
+    uint64_t free = s->size - s->used;
+    s->frag = free ? 1000 - s->largest_free * 1000 / free : 0;
+
+    for (uint64_t i = 0; i < HEAP_RUN_BUCKETS; i++)
+        s->free_runs[i] = free_runs[i];
 
     INTS_OKAY;
+}
 
-    return 0;
+static inline uint64_t slab_class(uint64_t nBytes) {
+    if (nBytes <= 1ull << SLAB_MIN_SHIFT)
+        return 0;
+
+    return 64 - __builtin_clzll(nBytes - 1) - SLAB_MIN_SHIFT;
 }
 
-#ifdef KERNEL
-void* palloc() {
-    if (heap == 0)
+static inline void unlink_slab(struct slab* s) {
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        partial[s->cls] = s->next;
+
+    if (s->next)
+        s->next->prev = s->prev;
+
+    s->next = s->prev = 0;
+}
+
+static inline void link_slab(struct slab* s) {
+    s->prev = 0;
+    s->next = partial[s->cls];
+    if (s->next)
+        s->next->prev = s;
+    partial[s->cls] = s;
+}
+
+// Call with interrupts off
+static struct slab* new_slab(uint64_t cls) {
+    uint64_t i = find_free_qword();
+    if (i == -1ull)
         return 0;
 
-    // heap64 % L2_PAGE_SZ is something...  Hmm, if we subtract that from a 512-map-qword-aligned...  Ugh, I think it's fine how we have it!
-    uint64_t i = (((heap64 + map_size * QBLK_SZ) & ~(L2_PAGE_SZ - 1)) - L2_PAGE_SZ - heap64) / QBLK_SZ;
+    count_taken(i * ENTRIES_PER_QWORD, ENTRIES_PER_QWORD);
+    map[i] = SLAB_MAP_ENTRY;
+    update_summary(i, i);
+
+    struct slab* s = (struct slab*) ((void*) heap + i * QBLK_SZ);
+    s->free = 0;
+    s->bump = slab_first_obj(cls);
+    s->inuse = 0;
+    s->cls = cls;
+    link_slab(s);
+
+    return s;
+}
+
+static void* slab_alloc(uint64_t cls) {
+    void* p;
 
     NO_INTS;
-    for (; i > 0; i -= L2_PAGE_SZ / QBLK_SZ) {
-        for (uint64_t j = 0; j < 512; j++)
-            if (map[i + j])
-                goto next;
 
-        for (uint64_t j = 0; j < 512; j++)
-            map[i + j] = -1ull;
+    struct slab* s = partial[cls];
+    if (!s && !(s = new_slab(cls))) {
+        INTS_OKAY;
+        return 0;
+    }
+
+    if (s->free) {
+        p = s->free;
+        s->free = *(void**) p;
+    } else {
+        p = (void*) s + s->bump;
+        s->bump += slab_obj_sz(cls);
+    }
+
+    if (++s->inuse == slab_cap(cls))
+        unlink_slab(s);
+
+    live_allocs++;
+    total_allocs++;
+
+    INTS_OKAY;
+    return p;
+}
+
+// n is index of map qword covering the slab; call with interrupts off
+static void slab_free(void* p, uint64_t n) {
+    struct slab* s = (struct slab*) ((void*) heap + n * QBLK_SZ);
+
+    *(void**) p = s->free;
+    s->free = p;
+
+    if (s->inuse-- == slab_cap(s->cls))
+        link_slab(s);
+
+    // Keep one empty slab around per class so alloc/free right at a slab boundary doesn't bounce through the map
+    if (s->inuse == 0 && (s->prev || s->next)) {
+        unlink_slab(s);
+        map[n] = 0;
+        update_summary(n, n);
+        count_released(n * ENTRIES_PER_QWORD, ENTRIES_PER_QWORD);
+    }
+}
+
+static inline int is_slab_obj(uint64_t n, uint64_t o) {
+    return ((map[n] >> o) & 0b11) == BSLAB;
+}
+
+// With the profiler built in, the public functions wrap these, so it sees each caller's allocation once (and a realloc that moves
+//   doesn't also show up as a malloc and a free from in here).  Without it, the public names are aliases for these, so there's
+//   nothing extra at all.
+static void* domalloc(uint64_t nBytes) {
+    if (heap == 0 || nBytes == 0)
+        return 0;
+
+    if (nBytes <= SLAB_MAX_OBJ)
+        return slab_alloc(slab_class(nBytes));
 
-        map[i + 511] -= 1;
+    uint64_t needed = blocks_per(nBytes, BLK_SZ);
 
+    NO_INTS;
+
+    uint64_t b = find_blocks(needed);
+    if (b == -1ull) {
         INTS_OKAY;
-        return (void*) heap + i * QBLK_SZ;
-    next:
+        return 0;
     }
+
+    count_taken(b, needed);
+    mark_blocks(b, needed);
+    update_summary(b / ENTRIES_PER_QWORD, (b + needed - 1) / ENTRIES_PER_QWORD);
+    live_allocs++;
+    total_allocs++;
+
     INTS_OKAY;
-    return 0;
+    return (void*) heap + b * BLK_SZ;
 }
-#endif
 
-void* mallocz(uint64_t nBytes) {
-    uint64_t* p = malloc(nBytes);
+static void* domallocz(uint64_t nBytes) {
+    uint64_t* p = domalloc(nBytes);
     if (!p)
         return 0;
 
-    for (uint64_t i = 0; i < blocks_per(nBytes, 8); i++)
-        p[i] = 0;
+    memset(p, 0, blocks_per(nBytes, 8) * 8);
 
     return p;
 }
 
-void free(void *p) {
+static void dofree(void *p) {
     if (heap == 0 || p < (void*) heap || p > (void*) heap + (map_size * (64 / MAP_ENTRY_SZ) - 1) * BLK_SZ)
         return;
 
-    uint64_t n = (uint64_t) p - heap64;
-    uint64_t o = (n % QBLK_SZ) / BLK_SZ * MAP_ENTRY_SZ;
-    n /= QBLK_SZ;
+    uint64_t b = ((uint64_t) p - heap64) / BLK_SZ;
+    uint64_t n = b / ENTRIES_PER_QWORD;
 
     // If we were only ever changing a whole qword at time I think we'd be fine without turning of interrupts, but since each entry
     //   is only a couple bits, someone else may also want to change another part of a given qword at the same time.
     NO_INTS;
-    for (uint64_t mask = 0b11ull << o;; n++, mask = 0b11ull, o = 0) {
-        for (; mask && (map[n] & mask) == BPART << o; mask <<= 2, o += 2)
-            map[n] &= ~mask;
+    live_allocs--;
 
-        if ((map[n] & mask) == BEND << o) {
-            map[n] &= ~mask;
-            break;
-        }
+    if (is_slab_obj(n, b % ENTRIES_PER_QWORD * MAP_ENTRY_SZ)) {
+        slab_free(p, n);
+        INTS_OKAY;
+        return;
     }
+
+    uint64_t e = alloc_end(b);
+    clear_blocks(b, e - b + 1);
+    update_summary(n, e / ENTRIES_PER_QWORD);
+    count_released(b, e - b + 1);
     INTS_OKAY;
 }
 
 static void* dorealloc(void* p, uint64_t newSize, int zero) {
+    if (!p)
+        return zero ? domallocz(newSize) : domalloc(newSize);
+
     if (heap == 0 || p < (void*) heap || p > (void*) heap + (map_size * (64 / MAP_ENTRY_SZ) - 1) * BLK_SZ)
         return 0;
 
-    uint64_t nbc = blocks_per(newSize, BLK_SZ);
-    uint64_t n = (uint64_t) p - heap64;
-    uint64_t o = (n % QBLK_SZ) / BLK_SZ * MAP_ENTRY_SZ;
-    n /= QBLK_SZ;
+    uint64_t b = ((uint64_t) p - heap64) / BLK_SZ;
+    uint64_t n = b / ENTRIES_PER_QWORD;
 
-    uint64_t count = 0;
-    uint8_t freeing = 0;
     NO_INTS;
-    for (uint64_t mask = 0b11ull << o;; n++, mask = 0b11ull, o = 0) {
-        for (; mask && (map[n] & mask) == BPART << o; mask <<= MAP_ENTRY_SZ, o += MAP_ENTRY_SZ) {
-            count++;
-
-            if (freeing) {
-                map[n] &= ~mask;
-            } else if (count == nbc) {
-                freeing = 1;
-                map[n] &= ~(1ull << o);
-            }
-        }
 
-        if (mask && (map[n] & mask) == BEND << o) {
-            count++;
+    if (is_slab_obj(n, b % ENTRIES_PER_QWORD * MAP_ENTRY_SZ)) {
+        uint64_t sz = slab_obj_sz(((struct slab*) ((void*) heap + n * QBLK_SZ))->cls);
+        if (newSize <= sz) {
+            reallocs_in_place++;
+            INTS_OKAY;
+            return p;
+        }
 
-            if (freeing) {
-                map[n] &= ~mask;
-            } else if (count != nbc) {
-                uint64_t* q = malloc(newSize);
+        uint64_t* q = domalloc(newSize);
+        if (q) {
+            memcpy(q, p, sz);
+            if (zero)
+                memset((void*) q + sz, 0, blocks_per(newSize, 8) * 8 - sz);
 
-                uint64_t i;
-                for (i = 0; i < count * BLK_SZ / 8; i++)
-                    q[i] = ((uint64_t*) p)[i];
-                if (zero)
-                    for (; i < newSize / 8; i++)
-                        q[i] = 0;
+            dofree(p);
+            reallocs_moved++;
+            realloc_copied += sz;
+        }
 
-                free(p);
-                p = q;
-            }
+        INTS_OKAY;
+        return q;
+    }
 
-            break;
+    uint64_t nbc = blocks_per(newSize, BLK_SZ);
+    uint64_t e = alloc_end(b);
+    uint64_t count = e - b + 1;
+
+    if (nbc == 0)
+        nbc = 1;
+
+    if (nbc < count) {
+        clear_blocks(b + nbc, count - nbc);
+        map[(b + nbc - 1) / ENTRIES_PER_QWORD] &= ~(1ull << ((b + nbc - 1) % ENTRIES_PER_QWORD * MAP_ENTRY_SZ));
+        update_summary((b + nbc - 1) / ENTRIES_PER_QWORD, e / ENTRIES_PER_QWORD);
+        count_released(b + nbc, count - nbc);
+        reallocs_in_place++;
+    } else if (nbc > count && free_after(e + 1) >= nbc - count) {
+        // Room right after us, so just take it: old end becomes a middle block, and the new blocks run to the new end
+        count_taken(e + 1, nbc - count);
+        map[e / ENTRIES_PER_QWORD] |= 1ull << (e % ENTRIES_PER_QWORD * MAP_ENTRY_SZ); // BEND -> BPART
+        mark_blocks(e + 1, nbc - count);
+        update_summary(e / ENTRIES_PER_QWORD, (b + nbc - 1) / ENTRIES_PER_QWORD);
+        reallocs_in_place++;
+
+        if (zero)
+            memset(p + count * BLK_SZ, 0, blocks_per(newSize, 8) * 8 - count * BLK_SZ);
+    } else if (nbc > count) {
+        uint64_t* q = domalloc(newSize);
+        if (!q) {
+            INTS_OKAY;
+            return 0;
         }
+
+        memcpy(q, p, count * BLK_SZ);
+        if (zero)
+            memset((void*) q + count * BLK_SZ, 0, blocks_per(newSize, 8) * 8 - count * BLK_SZ);
+
+        dofree(p);
+        p = q;
+        reallocs_moved++;
+        realloc_copied += count * BLK_SZ;
     }
 
     INTS_OKAY;
     return p;
 }
 
+#if defined(KERNEL) && defined(ALLOC_PROFILE)
+
+void* malloc(uint64_t nBytes) {
+    void* p = domalloc(nBytes);
+    PROF_ALLOC(p, nBytes);
+    return p;
+}
+
+void* mallocz(uint64_t nBytes) {
+    void* p = domallocz(nBytes);
+    PROF_ALLOC(p, nBytes);
+    return p;
+}
+
+void free(void* p) {
+    PROF_FREE(p);
+    dofree(p);
+}
+
+void* realloc(void* p, uint64_t newSize) {
+    void* q = dorealloc(p, newSize, 0);
+    PROF_REALLOC(p, q, newSize);
+    return q;
+}
+
+// See reallocz below
+void* reallocz(void* p, uint64_t newSize) {
+    void* q = dorealloc(p, newSize, 1);
+    PROF_REALLOC(p, q, newSize);
+    return q;
+}
+
+#else
+
+void* malloc(uint64_t nBytes) __attribute__((alias("domalloc")));
+void* mallocz(uint64_t nBytes) __attribute__((alias("domallocz")));
+void free(void* p) __attribute__((alias("dofree")));
+
 void* realloc(void* p, uint64_t newSize) {
     return dorealloc(p, newSize, 0);
 }
@@ -250,3 +783,5 @@ void* realloc(void* p, uint64_t newSize) {
 void* reallocz(void* p, uint64_t newSize) {
     return dorealloc(p, newSize, 1);
 }
+
+#endif
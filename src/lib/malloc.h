@@ -2,14 +2,29 @@
 
 #include <stdint.h>
 
+#define HEAP_RUN_BUCKETS 32
+
+struct heap_stats {
+    uint64_t size;         // Bytes in heap
+    uint64_t used;         // Bytes in allocated blocks (including all of any slab)
+    uint64_t peak;         // Most `used' has ever been
+    uint64_t allocs;       // Allocations currently live
+    uint64_t total_allocs; // Allocations ever made
+    uint64_t block_size;
+    uint64_t largest_free; // Bytes in longest free run (so the biggest malloc that can succeed)
+    uint64_t frag;         // Per mille of free space not in the longest free run
+    uint64_t reallocs_in_place;
+    uint64_t reallocs_moved;
+    uint64_t realloc_copied; // Bytes copied by reallocs that had to move
+    uint64_t free_runs[HEAP_RUN_BUCKETS]; // Free runs of [2^n, 2^(n+1)) blocks
+};
+
 void init_heap(uint64_t* start, uint64_t size);
 void* malloc(uint64_t nBytes);
-#ifdef KERNEL
-void* palloc();
-#endif
 void* mallocz(uint64_t nBytes);
 void free(void*);
 void* realloc(void* p, uint64_t newSize);
 void* reallocz(void* p, uint64_t newSize);
 uint64_t heapUsed();
 uint64_t heapSize();
+void getHeapStats(struct heap_stats* s);
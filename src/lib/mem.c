@@ -0,0 +1,140 @@
+#include <stdint.h>
+
+#include "mem.h"
+
+// CPUs with ERMS (enhanced rep movsb/stosb) make `rep movsb' and `rep stosb' the fastest way to copy or fill anything but small
+//   regions, and with FSRM (fast short rep mov) small ones too.  Otherwise rep movsq/stosq for the bulk and bytes for the tail is
+//   still good.  Below REP_MIN bytes (REP_MIN_FSRM with FSRM) rep's startup costs more than a plain loop, so small ones just loop.
+//
+// We ask CPUID on first use rather than needing an init call, so this works the same in the kernel, userspace, and host benches.
+//
+// GCC likes to turn byte-copying loops into calls to memcpy, which would be a problem in memcpy itself, hence NOT_MEMCPY.
+
+#define REP_MIN 64
+#define REP_MIN_FSRM 32
+#define NOT_MEMCPY __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+#define FEATURES_UNKNOWN 0x80
+#define FEATURE_ERMS 0x01
+#define FEATURE_FSRM 0x02
+
+typedef uint64_t __attribute__((may_alias, aligned(1))) any_qword;
+
+static uint8_t features = FEATURES_UNKNOWN;
+
+static uint8_t detect() {
+    uint32_t max, b, c, d;
+    __asm__ __volatile__("cpuid" : "=a"(max), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+
+    uint8_t f = 0;
+    if (max >= 7) {
+        uint32_t a;
+        __asm__ __volatile__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+        if (b & (1 << 9))
+            f |= FEATURE_ERMS;
+        if (d & (1 << 4))
+            f |= FEATURE_FSRM;
+    }
+
+    features = f;
+
+    return f;
+}
+
+static inline uint8_t cpuFeatures() {
+    return features & FEATURES_UNKNOWN ? detect() : features;
+}
+
+static inline int small(uint64_t n, uint8_t f) {
+    return n < (f & FEATURE_FSRM ? REP_MIN_FSRM : REP_MIN);
+}
+
+NOT_MEMCPY void* memcpy(void* dst, const void* src, uint64_t n) {
+    uint8_t f = cpuFeatures();
+    void* ret = dst;
+
+    if (small(n, f)) {
+        uint8_t* d = dst;
+        const uint8_t* s = src;
+        for (; n >= 8; n -= 8, d += 8, s += 8)
+            *(any_qword*) d = *(const any_qword*) s;
+        while (n--)
+            *d++ = *s++;
+
+        return ret;
+    }
+
+    if (f & FEATURE_ERMS) {
+        __asm__ __volatile__("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) :: "memory");
+    } else {
+        uint64_t q = n / 8;
+        n %= 8;
+        __asm__ __volatile__("rep movsq\n"
+                             "mov %3, %%rcx\n"
+                             "rep movsb"
+                             : "+D"(dst), "+S"(src), "+c"(q) : "r"(n) : "memory");
+    }
+
+    return ret;
+}
+
+// Forward copies are fine whenever dst is below src (or they don't overlap); otherwise go from the end down
+NOT_MEMCPY void* memmove(void* dst, const void* src, uint64_t n) {
+    if ((uint64_t) dst - (uint64_t) src >= n)
+        return memcpy(dst, src, n);
+
+    uint8_t* d = (uint8_t*) dst + n;
+    const uint8_t* s = (const uint8_t*) src + n;
+    for (; n >= 8; n -= 8) {
+        d -= 8;
+        s -= 8;
+        *(any_qword*) d = *(const any_qword*) s;
+    }
+    while (n--)
+        *--d = *--s;
+
+    return dst;
+}
+
+NOT_MEMCPY void* memset(void* dst, int c, uint64_t n) {
+    uint8_t f = cpuFeatures();
+    void* ret = dst;
+    uint64_t pattern = 0x0101010101010101ull * (uint8_t) c;
+
+    if (small(n, f)) {
+        uint8_t* d = dst;
+        for (; n >= 8; n -= 8, d += 8)
+            *(any_qword*) d = pattern;
+        while (n--)
+            *d++ = (uint8_t) c;
+
+        return ret;
+    }
+
+    if (f & FEATURE_ERMS) {
+        __asm__ __volatile__("rep stosb" : "+D"(dst), "+c"(n) : "a"(c) : "memory");
+    } else {
+        uint64_t q = n / 8;
+        n %= 8;
+        __asm__ __volatile__("rep stosq\n"
+                             "mov %2, %%rcx\n"
+                             "rep stosb"
+                             : "+D"(dst), "+c"(q) : "r"(n), "a"(pattern) : "memory");
+    }
+
+    return ret;
+}
+
+NOT_MEMCPY void* memset16(void* dst, uint16_t w, uint64_t count) {
+    uint64_t pattern = 0x0001000100010001ull * w;
+    uint64_t q = count / 4;
+    count %= 4;
+
+    void* d = dst;
+    __asm__ __volatile__("rep stosq\n"
+                         "mov %2, %%rcx\n"
+                         "rep stosw"
+                         : "+D"(d), "+c"(q) : "r"(count), "a"(pattern) : "memory");
+
+    return dst;
+}
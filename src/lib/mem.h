@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+void* memcpy(void* dst, const void* src, uint64_t n);
+void* memmove(void* dst, const void* src, uint64_t n);
+void* memset(void* dst, int c, uint64_t n);
+void* memset16(void* dst, uint16_t w, uint64_t count); // Fills count words (VGA text cells, say)
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary min-heap in a growable array.  DEFINE_MIN_HEAP(name, type, less, moved) declares `struct name' and static inline
+//   name##Push, name##Pop, etc., with less(a, b) (on two `type's) inlined into the sifts.  moved(item_ptr, i) is called whenever an
+//   item lands at index i, so items that need to be removed early (cancelled timers, say) can remember where they are and be
+//   passed to name##RemoveAt; use MIN_HEAP_UNINDEXED if that's not needed.  A zeroed struct is an empty heap.  Uses realloc, so
+//   includers need malloc.h too.
+
+#define MIN_HEAP_MIN_CAP 8
+
+#define MIN_HEAP_UNINDEXED(item, i)
+
+#define DEFINE_MIN_HEAP(name, type, less, moved)                                           \
+struct name {                                                                              \
+    type* items;                                                                           \
+    uint64_t len;                                                                          \
+    uint64_t cap;                                                                          \
+};                                                                                         \
+                                                                                           \
+static inline void name##Place(struct name* h, type item, uint64_t i) {                   \
+    h->items[i] = item;                                                                    \
+    moved(&h->items[i], i);                                                                \
+}                                                                                          \
+                                                                                           \
+static inline void name##SiftUp(struct name* h, uint64_t i) {                              \
+    type item = h->items[i];                                                               \
+    for (; i > 0 && less(item, h->items[(i - 1) / 2]); i = (i - 1) / 2)                    \
+        name##Place(h, h->items[(i - 1) / 2], i);                                          \
+                                                                                           \
+    name##Place(h, item, i);                                                               \
+}                                                                                          \
+                                                                                           \
+static inline void name##SiftDown(struct name* h, uint64_t i) {                            \
+    type item = h->items[i];                                                               \
+    for (;;) {                                                                             \
+        uint64_t c = i * 2 + 1;                                                            \
+        if (c >= h->len)                                                                   \
+            break;                                                                         \
+        if (c + 1 < h->len && less(h->items[c + 1], h->items[c]))                          \
+            c++;                                                                           \
+        if (!less(h->items[c], item))                                                      \
+            break;                                                                         \
+                                                                                           \
+        name##Place(h, h->items[c], i);                                                    \
+        i = c;                                                                             \
+    }                                                                                      \
+                                                                                           \
+    name##Place(h, item, i);                                                               \
+}                                                                                          \
+                                                                                           \
+/* Returns 0 (leaving h as it was) if out of memory */                                     \
+static inline int name##Push(struct name* h, type item) {                                  \
+    if (h->len == h->cap) {                                                                \
+        uint64_t cap = h->cap ? h->cap * 2 : MIN_HEAP_MIN_CAP;                             \
+        type* items = realloc(h->items, cap * sizeof(type));                               \
+        if (!items)                                                                        \
+            return 0;                                                                      \
+                                                                                           \
+        h->items = items;                                                                  \
+        h->cap = cap;                                                                      \
+    }                                                                                      \
+                                                                                           \
+    h->items[h->len++] = item;                                                             \
+    name##SiftUp(h, h->len - 1);                                                           \
+                                                                                           \
+    return 1;                                                                              \
+}                                                                                          \
+                                                                                           \
+/* Smallest item, or 0 if empty */                                                         \
+static inline type* name##Peek(struct name* h) {                                           \
+    return h->len ? &h->items[0] : 0;                                                      \
+}                                                                                          \
+                                                                                           \
+static inline void name##RemoveAt(struct name* h, uint64_t i) {                            \
+    if (--h->len == i)                                                                     \
+        return;                                                                            \
+                                                                                           \
+    h->items[i] = h->items[h->len];                                                        \
+    if (i > 0 && less(h->items[i], h->items[(i - 1) / 2]))                                 \
+        name##SiftUp(h, i);                                                                \
+    else                                                                                   \
+        name##SiftDown(h, i);                                                              \
+}                                                                                          \
+                                                                                           \
+/* Caller checks len first */                                                              \
+static inline type name##Pop(struct name* h) {                                             \
+    type top = h->items[0];                                                                \
+    name##RemoveAt(h, 0);                                                                  \
+                                                                                           \
+    return top;                                                                            \
+}
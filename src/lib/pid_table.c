@@ -0,0 +1,133 @@
+#include <stdint.h>
+
+#include "pid_table.h"
+
+#include "malloc.h"
+
+// Open addressing with linear probing, keyed directly by pid & mask.  Pids are handed out sequentially, so live pids mostly sit
+//   in their own home slots and a lookup is usually a single compare; the table doubles before it's half full, so probes stay
+//   short however many processes there are.  Removal shifts later members of the probe run back rather than leaving tombstones,
+//   so a long-running system with lots of churn doesn't slowly fill up with them.
+//
+// Pids count up to max_pid and then wrap back around to 1, skipping any still in use, so pids aren't reused any sooner than they
+//   have to be.
+
+#define INIT_CAP 64
+
+struct pid_slot {
+    uint64_t pid; // 0 means empty
+    void* item;
+};
+
+struct pid_table {
+    struct pid_slot* slots;
+    uint64_t mask;
+    uint64_t len;
+    uint64_t last_pid;
+    uint64_t max_pid;
+};
+
+struct pid_table* newPidTable(uint64_t max_pid) {
+    struct pid_table* t = malloc(sizeof(struct pid_table));
+    if (!t)
+        return 0;
+
+    t->slots = mallocz(INIT_CAP * sizeof(struct pid_slot));
+    if (!t->slots) {
+        free(t);
+        return 0;
+    }
+
+    t->mask = INIT_CAP - 1;
+    t->len = 0;
+    t->last_pid = 0;
+    t->max_pid = max_pid;
+
+    return t;
+}
+
+uint64_t pidTableLen(struct pid_table* t) {
+    return t->len;
+}
+
+static inline struct pid_slot* slotFor(struct pid_table* t, uint64_t pid) {
+    uint64_t i = pid & t->mask;
+    while (t->slots[i].pid && t->slots[i].pid != pid)
+        i = (i + 1) & t->mask;
+
+    return &t->slots[i];
+}
+
+static int grow(struct pid_table* t) {
+    uint64_t cap = (t->mask + 1) * 2;
+    struct pid_slot* slots = mallocz(cap * sizeof(struct pid_slot));
+    if (!slots)
+        return 0;
+
+    struct pid_slot* old = t->slots;
+    uint64_t old_cap = t->mask + 1;
+    t->slots = slots;
+    t->mask = cap - 1;
+
+    for (uint64_t i = 0; i < old_cap; i++)
+        if (old[i].pid)
+            *slotFor(t, old[i].pid) = old[i];
+
+    free(old);
+
+    return 1;
+}
+
+uint64_t pidTableAdd(struct pid_table* t, void* item) {
+    if (t->len >= t->max_pid)
+        return 0;
+
+    if ((t->len + 1) * 2 > t->mask + 1 && !grow(t))
+        return 0;
+
+    struct pid_slot* s;
+    do {
+        t->last_pid = t->last_pid >= t->max_pid ? 1 : t->last_pid + 1;
+        s = slotFor(t, t->last_pid);
+    } while (s->pid);
+
+    s->pid = t->last_pid;
+    s->item = item;
+    t->len++;
+
+    return s->pid;
+}
+
+void* pidTableGet(struct pid_table* t, uint64_t pid) {
+    if (!pid)
+        return 0;
+
+    return slotFor(t, pid)->item;
+}
+
+void* pidTableRemove(struct pid_table* t, uint64_t pid) {
+    if (!pid)
+        return 0;
+
+    struct pid_slot* s = slotFor(t, pid);
+    if (!s->pid)
+        return 0;
+
+    void* item = s->item;
+    t->len--;
+
+    // Walk the rest of the probe run, pulling back anything whose home slot means it would no longer be found past the hole
+    uint64_t hole = s - t->slots;
+    for (uint64_t i = (hole + 1) & t->mask; t->slots[i].pid; i = (i + 1) & t->mask) {
+        uint64_t home = t->slots[i].pid & t->mask;
+        if (((i - home) & t->mask) >= ((i - hole) & t->mask)) {
+            t->slots[hole] = t->slots[i];
+            hole = i;
+        }
+    }
+
+    t->slots[hole].pid = 0;
+    t->slots[hole].item = 0;
+
+    return item;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Maps pids to items (processes, for the kernel); also hands out the pids.
+
+struct pid_table;
+
+struct pid_table* newPidTable(uint64_t max_pid);
+uint64_t pidTableLen(struct pid_table* t);
+uint64_t pidTableAdd(struct pid_table* t, void* item); // Returns new pid for item, or 0 if out of pids or memory
+void* pidTableGet(struct pid_table* t, uint64_t pid);
+void* pidTableRemove(struct pid_table* t, uint64_t pid); // Returns item that had pid, if any
@@ -0,0 +1,251 @@
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// The usual (CLRS-style) algorithms, with a missing child standing in for a black leaf.
+
+#define isRed(n) ((n) && (n)->red)
+
+static void replaceChild(struct rb_root* root, struct rb_node* parent, struct rb_node* old, struct rb_node* new) {
+    if (!parent)
+        root->node = new;
+    else if (parent->left == old)
+        parent->left = new;
+    else
+        parent->right = new;
+}
+
+static void rotateLeft(struct rb_root* root, struct rb_node* n) {
+    struct rb_node* r = n->right;
+
+    n->right = r->left;
+    if (r->left)
+        r->left->parent = n;
+
+    r->parent = n->parent;
+    replaceChild(root, n->parent, n, r);
+
+    r->left = n;
+    n->parent = r;
+}
+
+static void rotateRight(struct rb_root* root, struct rb_node* n) {
+    struct rb_node* l = n->left;
+
+    n->left = l->right;
+    if (l->right)
+        l->right->parent = n;
+
+    l->parent = n->parent;
+    replaceChild(root, n->parent, n, l);
+
+    l->right = n;
+    n->parent = l;
+}
+
+void rbInsertColor(struct rb_root* root, struct rb_node* n) {
+    n->red = 1;
+
+    struct rb_node* p;
+    while ((p = n->parent) && p->red) {
+        struct rb_node* g = p->parent; // Exists, since the root is black
+        if (p == g->left) {
+            struct rb_node* u = g->right;
+            if (isRed(u)) {
+                p->red = u->red = 0;
+                g->red = 1;
+                n = g;
+                continue;
+            }
+
+            if (n == p->right) {
+                rotateLeft(root, p);
+                n = p;
+                p = n->parent;
+            }
+
+            p->red = 0;
+            g->red = 1;
+            rotateRight(root, g);
+        } else {
+            struct rb_node* u = g->left;
+            if (isRed(u)) {
+                p->red = u->red = 0;
+                g->red = 1;
+                n = g;
+                continue;
+            }
+
+            if (n == p->left) {
+                rotateRight(root, p);
+                n = p;
+                p = n->parent;
+            }
+
+            p->red = 0;
+            g->red = 1;
+            rotateLeft(root, g);
+        }
+    }
+
+    root->node->red = 0;
+}
+
+// Restores black heights after a black node was removed from under parent, leaving x (possibly missing) one black short
+static void eraseFixup(struct rb_root* root, struct rb_node* x, struct rb_node* parent) {
+    while (x != root->node && !isRed(x)) {
+        if (x == parent->left) {
+            struct rb_node* w = parent->right;
+            if (w->red) {
+                w->red = 0;
+                parent->red = 1;
+                rotateLeft(root, parent);
+                w = parent->right;
+            }
+
+            if (!isRed(w->left) && !isRed(w->right)) {
+                w->red = 1;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+
+            if (!isRed(w->right)) {
+                w->left->red = 0;
+                w->red = 1;
+                rotateRight(root, w);
+                w = parent->right;
+            }
+
+            w->red = parent->red;
+            parent->red = 0;
+            w->right->red = 0;
+            rotateLeft(root, parent);
+            x = root->node;
+        } else {
+            struct rb_node* w = parent->left;
+            if (w->red) {
+                w->red = 0;
+                parent->red = 1;
+                rotateRight(root, parent);
+                w = parent->left;
+            }
+
+            if (!isRed(w->left) && !isRed(w->right)) {
+                w->red = 1;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+
+            if (!isRed(w->left)) {
+                w->right->red = 0;
+                w->red = 1;
+                rotateLeft(root, w);
+                w = parent->left;
+            }
+
+            w->red = parent->red;
+            parent->red = 0;
+            w->left->red = 0;
+            rotateRight(root, parent);
+            x = root->node;
+        }
+    }
+
+    if (x)
+        x->red = 0;
+}
+
+void rbErase(struct rb_root* root, struct rb_node* n) {
+    struct rb_node* x;
+    struct rb_node* x_parent;
+    uint64_t removed_red;
+
+    if (!n->left || !n->right) {
+        x = n->left ? n->left : n->right;
+        x_parent = n->parent;
+        removed_red = n->red;
+
+        if (x)
+            x->parent = x_parent;
+        replaceChild(root, x_parent, n, x);
+    } else {
+        // Two children: n's successor y (leftmost in the right subtree, so no left child) takes n's place and color
+        struct rb_node* y = n->right;
+        while (y->left)
+            y = y->left;
+
+        x = y->right;
+        removed_red = y->red;
+
+        if (y->parent == n) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            x_parent->left = x;
+            if (x)
+                x->parent = x_parent;
+
+            y->right = n->right;
+            y->right->parent = y;
+        }
+
+        y->left = n->left;
+        y->left->parent = y;
+        y->parent = n->parent;
+        y->red = n->red;
+        replaceChild(root, n->parent, n, y);
+    }
+
+    if (!removed_red)
+        eraseFixup(root, x, x_parent);
+}
+
+struct rb_node* rbFirst(struct rb_root* root) {
+    struct rb_node* n = root->node;
+    if (n)
+        while (n->left)
+            n = n->left;
+
+    return n;
+}
+
+struct rb_node* rbLast(struct rb_root* root) {
+    struct rb_node* n = root->node;
+    if (n)
+        while (n->right)
+            n = n->right;
+
+    return n;
+}
+
+struct rb_node* rbNext(struct rb_node* n) {
+    if (n->right) {
+        n = n->right;
+        while (n->left)
+            n = n->left;
+
+        return n;
+    }
+
+    while (n->parent && n == n->parent->right)
+        n = n->parent;
+
+    return n->parent;
+}
+
+struct rb_node* rbPrev(struct rb_node* n) {
+    if (n->left) {
+        n = n->left;
+        while (n->right)
+            n = n->right;
+
+        return n;
+    }
+
+    while (n->parent && n == n->parent->left)
+        n = n->parent;
+
+    return n->parent;
+}
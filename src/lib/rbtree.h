@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// Intrusive red-black tree: a `struct rb_node' lives inside each item, so nothing is allocated.  Rebalancing is the same for every
+//   tree, so it's out of line in rbtree.c; searching is where the comparisons are, so DEFINE_RBTREE(name, type, member, key_type,
+//   key) generates inline name##Insert and name##Find with key(item_ptr) (giving a key_type that compares with < and ==) inlined.
+//   Equal keys are allowed; they come back out in insertion order.  A zeroed struct rb_root is an empty tree.
+//
+// Iterate in order with:  for (struct rb_node* n = rbFirst(&root); n; n = rbNext(n)) { ... name##Item(n) ... }
+
+struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    uint64_t red;
+};
+
+struct rb_root {
+    struct rb_node* node;
+};
+
+void rbInsertColor(struct rb_root* root, struct rb_node* n); // n just linked in as a leaf
+void rbErase(struct rb_root* root, struct rb_node* n);
+struct rb_node* rbFirst(struct rb_root* root);
+struct rb_node* rbLast(struct rb_root* root);
+struct rb_node* rbNext(struct rb_node* n);
+struct rb_node* rbPrev(struct rb_node* n);
+
+#define DEFINE_RBTREE(name, type, member, key_type, key)                                   \
+static inline type* name##Item(struct rb_node* n) {                                        \
+    return n ? (type*) ((uint8_t*) n - __builtin_offsetof(type, member)) : (type*) 0;     \
+}                                                                                          \
+                                                                                           \
+static inline void name##Insert(struct rb_root* root, type* item) {                        \
+    key_type k = key(item);                                                                \
+    struct rb_node** link = &root->node;                                                   \
+    struct rb_node* parent = 0;                                                            \
+                                                                                           \
+    while (*link) {                                                                        \
+        parent = *link;                                                                    \
+        link = k < key(name##Item(parent)) ? &parent->left : &parent->right;               \
+    }                                                                                      \
+                                                                                           \
+    struct rb_node* n = &item->member;                                                     \
+    n->parent = parent;                                                                    \
+    n->left = n->right = 0;                                                                \
+    *link = n;                                                                             \
+    rbInsertColor(root, n);                                                                \
+}                                                                                          \
+                                                                                           \
+/* First item (in order) with key k, or 0 */                                               \
+static inline type* name##Find(struct rb_root* root, key_type k) {                         \
+    struct rb_node* n = root->node;                                                        \
+    type* found = 0;                                                                       \
+                                                                                           \
+    while (n) {                                                                            \
+        type* item = name##Item(n);                                                        \
+        if (k < key(item)) {                                                               \
+            n = n->left;                                                                   \
+        } else if (k == key(item)) {                                                       \
+            found = item;                                                                  \
+            n = n->left;                                                                   \
+        } else {                                                                           \
+            n = n->right;                                                                  \
+        }                                                                                  \
+    }                                                                                      \
+                                                                                           \
+    return found;                                                                          \
+}
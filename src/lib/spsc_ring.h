@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-size single-producer/single-consumer ring.  DEFINE_SPSC_RING(name, type, order) declares `struct name', holding 2^order
+//   `type's, and static inline name##Push, name##Pop and name##PopBatch.  The producer (an IRQ handler, say) only ever writes
+//   tail and the consumer only ever writes head, each in its own cache line, so neither needs to turn interrupts off or take a
+//   lock, and a push is a handful of instructions that can't wait or allocate.  A full ring drops the new item and counts it in
+//   overflows rather than growing; high_water is the most the ring has ever held, for sizing it.  A zeroed struct is empty.
+
+#define spscLoad(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define spscStore(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+#define DEFINE_SPSC_RING(name, type, order)                                                \
+struct name {                                                                              \
+    uint64_t head __attribute__((aligned(64))); /* Next to pop; written only by consumer */ \
+    uint64_t tail __attribute__((aligned(64))); /* Next to fill; written only by producer */ \
+    uint64_t overflows;                                                                    \
+    uint64_t high_water;                                                                   \
+    type slots[1ull << (order)] __attribute__((aligned(64)));                              \
+};                                                                                         \
+                                                                                           \
+/* Returns 0 (and counts an overflow) if full */                                           \
+static inline int name##Push(struct name* r, type item) {                                  \
+    uint64_t t = r->tail;                                                                  \
+    uint64_t used = t - spscLoad(r->head);                                                 \
+    if (used == 1ull << (order)) {                                                         \
+        r->overflows++;                                                                    \
+        return 0;                                                                          \
+    }                                                                                      \
+                                                                                           \
+    r->slots[t & ((1ull << (order)) - 1)] = item;                                          \
+    spscStore(r->tail, t + 1);                                                             \
+                                                                                           \
+    if (used + 1 > r->high_water)                                                          \
+        r->high_water = used + 1;                                                          \
+                                                                                           \
+    return 1;                                                                              \
+}                                                                                          \
+                                                                                           \
+/* Returns 0 if empty */                                                                   \
+static inline int name##Pop(struct name* r, type* out) {                                   \
+    uint64_t h = r->head;                                                                  \
+    if (h == spscLoad(r->tail))                                                            \
+        return 0;                                                                          \
+                                                                                           \
+    *out = r->slots[h & ((1ull << (order)) - 1)];                                          \
+    spscStore(r->head, h + 1);                                                             \
+                                                                                           \
+    return 1;                                                                              \
+}                                                                                          \
+                                                                                           \
+/* Takes up to max items at once (freeing their slots with a single store); returns how many */ \
+static inline uint64_t name##PopBatch(struct name* r, type* out, uint64_t max) {          \
+    uint64_t h = r->head;                                                                  \
+    uint64_t n = spscLoad(r->tail) - h;                                                    \
+    if (n > max)                                                                           \
+        n = max;                                                                           \
+                                                                                           \
+    for (uint64_t i = 0; i < n; i++)                                                       \
+        out[i] = r->slots[(h + i) & ((1ull << (order)) - 1)];                              \
+    spscStore(r->head, h + n);                                                             \
+                                                                                           \
+    return n;                                                                              \
+}
@@ -4,14 +4,7 @@
 #include "strings.h"
 
 #include "malloc.h"
-
-#define ONE_E_19 10000000000000000000ull
-
-static inline char* append(char* s, char* t) {
-    char* u = M_sappend(s, t);
-    free(s);
-    return u;
-}
+#include "mem.h"
 
 char* M_sprintf(char* fmt, ...) {
     va_list ap;
@@ -26,161 +19,247 @@ char* M_sprintf(char* fmt, ...) {
 char* sprintf(char* buf, uint64_t buf_len, char* fmt, ...) {
     va_list ap;
     va_start(ap, fmt);
-    char* s = M_vsprintf(buf, buf_len, fmt, ap);
+    vformat(buf, buf_len, fmt, ap);
     va_end(ap);
-    return s;
+    return buf;
 }
 
+// With no buffer, measures first and then allocates exactly enough; with one, it's just vformat.
 char* M_vsprintf(char* s, uint64_t s_cap, char* fmt, va_list ap) {
-    int dyn = 0;
-    if (!s) {
-        dyn = 1;
-        s_cap = 128;
-        s = malloc(s_cap);
+    if (s) {
+        vformat(s, s_cap, fmt, ap);
+        return s;
+    }
+
+    va_list ap2;
+    va_copy(ap2, ap);
+    uint64_t len = vformat(0, 0, fmt, ap2);
+    va_end(ap2);
+
+    s = malloc(len + 1);
+    if (s)
+        vformat(s, len + 1, fmt, ap);
+
+    return s;
+}
+
+// Formats into buf if the result fits, or else into exactly enough fresh memory; the caller frees the result if it isn't buf.
+char* M_vsprintfBuf(char* buf, uint64_t buf_cap, char* fmt, va_list ap) {
+    va_list ap2;
+    va_copy(ap2, ap);
+    uint64_t len = vformat(buf, buf_cap, fmt, ap2);
+    va_end(ap2);
+
+    if (len < buf_cap)
+        return buf;
+
+    return M_vsprintf(0, 0, fmt, ap);
+}
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// u / 100 for any 64-bit u, as a multiply by a fixed-point reciprocal (the ">> 2" first keeps the product within 128 bits)
+static inline uint64_t div100(uint64_t u) {
+    return (uint64_t) (((unsigned __int128) (u >> 2) * 0x28F5C28F5C28F5C3ull) >> 66);
+}
+
+// Writes u's digits so they end just before `end'; returns how many
+static uint64_t decimal(uint64_t u, char* end) {
+    char* p = end;
+
+    while (u >= 100) {
+        uint64_t q = div100(u);
+        uint64_t r = u - q * 100;
+        *--p = digit_pairs[r * 2 + 1];
+        *--p = digit_pairs[r * 2];
+        u = q;
+    }
+
+    if (u >= 10) {
+        *--p = digit_pairs[u * 2 + 1];
+        *--p = digit_pairs[u * 2];
+    } else {
+        *--p = '0' + u;
     }
-    char c, *t, padc;
-    int i = 0; // Index into s where we will place next character
-    int padw = 0;
-    char buf[21];
-    buf[20] = 0;
+
+    return end - p;
+}
+
+static uint64_t hex(uint64_t u, char* end) {
+    char* p = end;
+
+    do {
+        *--p = hex_digits[u & 0xf];
+        u >>= 4;
+    } while (u);
+
+    return end - p;
+}
+
+// Writes as much as fits in s (always terminating it, if there's room for that) and returns the length of the whole result, so
+//   vformat(0, 0, ...) just measures.
+//
+// Conversions are %u (decimal), %h (hex), %s, %c, and %%, any of which can be padded: %p<pad char><width><conversion>.  A number
+//   too wide for its width keeps only its last `width' digits, so %p02u is the last two digits, zero padded.
+uint64_t vformat(char* s, uint64_t s_cap, char* fmt, va_list ap) {
+    uint64_t i = 0; // Length so far, whether or not it's all fit
+    char buf[20];
+
+#define put(ch) do { if (i + 1 < s_cap) s[i] = (ch); i++; } while (0)
 
     for (char* p = fmt; *p; p++) {
-        if ((int64_t) s_cap - i < 4) { // We'll add at most 3 characters here, plus '\0' at end
-            if (dyn) {
-                s_cap *= 2;
-                s = realloc(s, s_cap);
-            } else {
-                break;
-            }
+        if (*p != '%') {
+            put(*p);
+            continue;
         }
 
-        if (padw == 0) {
-            if (*p != '%') {
-                s[i++] = *p;
+        char padc = ' ';
+        uint64_t padw = 0;
+
+        if (p[1] == 'p') {
+            if (!p[2] || p[3] < '0' || p[3] > '9') { // Bad format; let's bail on interpreting it
+                put('%');
+                put('p');
+                if (p[2] && p[3])
+                    put(p[3]);
+                p += !p[2] ? 1 : !p[3] ? 2 : 3;
+
                 continue;
             }
 
-            c = *++p; // Skip past the '%'
-        } else {
-            c = *p;
+            padc = p[2];
+            p += 3;
+            padw = dstoui(p);
+            while (p[1] >= '0' && p[1] <= '9')
+                p++;
         }
 
-        switch (c) {
-        case 'c':
-            t = buf + 19;
-            t[0] = va_arg(ap, int);
+        char c = *++p;
+        char* t = buf + sizeof(buf);
+        uint64_t len;
 
-            break;
+        switch (c) {
         case 'u':
-            uint64_t u = va_arg(ap, uint64_t);
-            uint64_t e = ONE_E_19;
-
-            for (int j = 0; j < 20; j++) {
-                uint64_t d = u / e;
-                buf[j] = d + '0';
-                u  = u % e;
-                e /= 10;
-            }
-
-            t = buf;
-
+            len = decimal(va_arg(ap, uint64_t), t);
             break;
         case 'h':
-            t = buf + 4; // Quad word in hex is 16 characters, not 20 as in decimal
-            qwordToHex(va_arg(ap, uint64_t), t);
-
+            len = hex(va_arg(ap, uint64_t), t);
+            break;
+        case 'c':
+            *--t = (char) va_arg(ap, int);
+            len = 1;
             break;
         case 's':
             t = va_arg(ap, char*);
-
-            break;
-        case 'p':
-            padc = *++p;
-
-            c = *++p;
-            if (c >= '0' && c <= '9') {
-                padw = dstoui(p);
-
-                while (*p >= '0' && *p <= '9')
-                    p++;
-
-                p--;
-            } else { // Bad format; let's bail on interpreting it
-                s[i++] = '%';
-                s[i++] = 'p';
-                s[i++] = c;
-            }
-
-            continue;
-
+            len = strlen(t);
             break;
         case '%':
-            s[i++] = c;
+            put('%');
+            continue;
+        case 0: // Format ends in a lone '%'
+            put('%');
+            p--;
             continue;
-            break;
         default:
-            s[i++] = '%';
-            s[i++] = c;
-
+            put('%');
+            put(c);
             continue;
         }
 
-        if (c == 'u' || c == 'h')
-            if (padc != '0' || padw <= 0)
-                while (*t == '0' && *(t + 1) != 0) t++;
-
-        if (padw > 0) {
-            int l = strlen(t);
-
-            if (padw >= l) {
-                padw -= l;
-            } else {
-                if (c == 'u' || c == 'h')
-                    t += l - padw; // Keep the zeros we want rather than stripping and re-adding
-                padw = 0;
+        if (c == 'u' || c == 'h') {
+            t -= len;
+            if (padw && len > padw) {
+                t += len - padw;
+                len = padw;
             }
         }
 
-        // Okay, no append for s; here is the one place we lengthen it other than the top.
-        uint64_t needed = i + strlen(t) + padw + 1;
-        if (s_cap < needed) {
-            if (dyn) {
-                s_cap = needed;
-                s = realloc(s, s_cap);
-            } else {
-                // We *could* do something more careful here, to make most of space left, but doesn't feel worth it.
-                break;
-            }
+        for (; padw > len; padw--)
+            put(padc);
+
+        if (i + len < s_cap) {
+            memcpy(s + i, t, len);
+            i += len;
+        } else {
+            for (uint64_t j = 0; j < len; j++)
+                put(t[j]);
         }
+    }
 
-        for (int j = 0; j < padw; j++)
-            s[i++] = padc;
+#undef put
 
-        while (*t)
-            s[i++] = *t++;
+    if (s_cap)
+        s[i < s_cap ? i : s_cap - 1] = 0;
 
-        padw = 0;
-    }
+    return i;
+}
 
-    s[i] = '\0';
+// Word-at-a-time: a qword has a zero byte iff (v - 0x01..01) & ~v & 0x80..80 is nonzero.  Aligned 8-byte reads never cross
+//   into another page, so reading a little past the terminator is safe.
+#define ONES 0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+#define hasZero(v) (((v) - ONES) & ~(v) & HIGHS)
+#define PAGE_OFFSET_MASK 4095
 
-    return s;
-}
+typedef uint64_t __attribute__((may_alias, aligned(1))) any_qword;
 
 uint64_t strlen(char* s) {
-    uint64_t i = 0;
-    while (s[i]) i++;
-    return i;
+    char* p = s;
+    for (; (uint64_t) p % 8; p++)
+        if (!*p)
+            return p - s;
+
+    any_qword* w = (any_qword*) p;
+    while (!hasZero(*w))
+        w++;
+
+    for (p = (char*) w; *p; p++)
+        ;
+
+    return p - s;
 }
 
+// s goes aligned; t may not be, so its qword reads are only done when they can't run onto the next page
 int strcmp(char* s, char* t) {
-    for (uint64_t i = 0;;i++) {
-        int d;
-        if ((d = s[i] - t[i]))
-            return d;
-        if (!s[i])
-            return 0;
+    for (; (uint64_t) s % 8; s++, t++)
+        if (*s != *t || !*s)
+            return *s - *t;
+
+    for (;;) {
+        if (((uint64_t) t & PAGE_OFFSET_MASK) > 4096 - 8) {
+            for (int i = 0; i < 8; i++, s++, t++)
+                if (*s != *t || !*s)
+                    return *s - *t;
+
+            continue;
+        }
+
+        uint64_t a = *(any_qword*) s, b = *(any_qword*) t;
+        if (a != b || hasZero(a))
+            break;
+
+        s += 8;
+        t += 8;
     }
+
+    while (*s == *t && *s) {
+        s++;
+        t++;
+    }
+
+    return *s - *t;
 }
 
 char* M_sappend(char* s, char* t) {
@@ -38,6 +38,8 @@ static inline void qwordToHex(uint64_t q, char* s) {
 char* M_sprintf(char* fmt, ...);
 char* sprintf(char* buf, uint64_t buf_len, char* fmt, ...);
 char* M_vsprintf(char* s, uint64_t s_cap, char* fmt, va_list ap);
+char* M_vsprintfBuf(char* buf, uint64_t buf_cap, char* fmt, va_list ap);
+uint64_t vformat(char* s, uint64_t s_cap, char* fmt, va_list ap);
 uint64_t strlen(char* s);
 int strcmp(char* s, char* t);
 char* M_sappend(char* s, char* t);
@@ -45,10 +47,15 @@ char* M_scopy(char* s);
 // Decimal string to unsigned int
 uint64_t dstoui(char* s);
 
+// Formats on the stack, only allocating for output too long for that
+#define VARIADIC_PRINT_BUF 256
+
 #define VARIADIC_PRINT(p) \
+    char buf[VARIADIC_PRINT_BUF]; \
     va_list ap; \
     va_start(ap, fmt); \
-    char* s = M_vsprintf(0, 0, fmt, ap);         \
+    char* s = M_vsprintfBuf(buf, VARIADIC_PRINT_BUF, fmt, ap); \
     va_end(ap); \
     p(s); \
-    free(s)
+    if (s != buf) \
+        free(s)
@@ -2,5 +2,97 @@
 
 struct sc_proc {
     uint64_t pid;
-    uint64_t ppid;
+    uint64_t ppid;    // 0 for none
+    uint64_t nice;
+    uint64_t level;   // Run queue it's on, 0 to SC_PRIO_LEVELS - 1 (from SC_BATCH_LEVEL on, it's batch work)
+    uint64_t running; // Whether it's the one asking
+    uint64_t cpu_us;  // 0 until the TSC is calibrated
+    uint64_t slices;
+    uint64_t preempted;
+};
+
+#define SC_PRIO_LEVELS 8
+#define SC_BATCH_LEVEL 4
+
+#define SC_WAKE_BUCKETS 16
+
+struct sc_sched_stats {
+    uint64_t wakeups;
+    uint64_t wake_preempts; // Times a running process was switched out early for something woken
+    uint64_t wake_us[SC_WAKE_BUCKETS]; // From the waking event to running: [0] is under 1 us, [i] is 2^(i-1) to 2^i us, last is more
+
+    uint64_t tickless;     // 1 if the timer is a one-shot set for the next deadline, 0 if it's the PIT ticking at 1000 Hz
+    uint64_t timer_irqs;
+    uint64_t idle_wakeups; // Times waitloop's hlt returned
+    uint64_t idle_ns;      // Time spent halted
+    uint64_t since_ns;     // Time since waitloop first ran, for rates and shares of the above
+};
+
+#define SC_WORK_NAME_LEN 16
+
+// One per kind of deferred work waitloop runs for interrupt handlers (see work.h)
+struct sc_work_stats {
+    char name[SC_WORK_NAME_LEN];
+    uint64_t lane;     // 0 is high priority, 1 low
+    uint64_t coalesce; // Whether it's queued at most once at a time
+    uint64_t runs;
+    uint64_t coalesced; // Times it was due again before it had run
+    uint64_t dropped;   // Times its lane was full
+    uint64_t delay_ns;  // Total from queued to started
+    uint64_t max_delay_ns;
+    uint64_t run_ns;    // Total running
+    uint64_t max_run_ns;
+};
+
+#define SC_CLOCK_REALTIME 0  // Since the Unix epoch
+#define SC_CLOCK_MONOTONIC 1 // Since boot; never goes backward
+
+struct sc_timespec {
+    uint64_t sec;
+    uint64_t nsec;
+};
+
+// One read-only page the kernel maps into every process at SC_KDATA_ADDR, just past its 2 MB page, so it can read these without a
+//   syscall.  The clock fields change under seq (see clock.c): read seq, then the fields, then seq again, and start over if it's
+//   changed.  The time is then clock_ns + ((rdtsc - clock_tsc) * clock_mult >> 32), plus realtime_ns for SC_CLOCK_REALTIME.
+
+#define SC_KDATA_ADDR 0x7FC0200000ull
+
+struct sc_kdata {
+    uint64_t seq;
+    uint64_t clock_ns;
+    uint64_t clock_tsc;
+    uint64_t clock_mult;  // ns per TSC tick << 32; 0 if the clock isn't the TSC, in which case clockGettime is a syscall after all
+    uint64_t realtime_ns; // Unix time at boot
+
+    uint64_t pid;    // Whoever's running, which from userspace means us
+    uint64_t stdout; // Our terminal
+
+    // As in sc_sched_stats, and kept here as they happen
+    uint64_t switches; // Times waitloop ran a process
+    uint64_t wakeups;
+    uint64_t wake_preempts;
+    uint64_t timer_irqs;
+    uint64_t idle_wakeups;
+    uint64_t idle_ns;
+    uint64_t sched_start_ns; // When waitloop first ran
+};
+
+struct sc_page_stats {
+    uint64_t page_size;
+    uint64_t total;
+    uint64_t free;
+    uint64_t low;     // Fewest pages that have ever been free
+    uint64_t usable;  // Bytes of memory the firmware says are usable
+    uint64_t managed; // Bytes of that we actually manage
+};
+
+#define SC_BOOT_STAGES 16
+#define SC_BOOT_NAME_LEN 16
+
+struct sc_boot_timeline {
+    uint64_t tsc_hz; // 0 until calibrated, a second or so after boot
+    uint64_t count;
+    uint64_t us[SC_BOOT_STAGES]; // Since first instruction of MBR; -1 if stage not reached (or not calibrated yet)
+    char names[SC_BOOT_STAGES][SC_BOOT_NAME_LEN];
 };
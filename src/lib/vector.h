@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// Growable array of a given type.  DEFINE_VECTOR(name, type) declares `struct name' and static inline name##Push and friends, so
+//   each vector gets code for its own element type and loops over one are plain loops the compiler can see through (no per-item
+//   function pointer call, as with forEachListItem).  A zeroed struct is an empty vector.  Uses realloc and free, so includers
+//   need malloc.h too.
+//
+// Iterate with:  vecForEach(it, &v) { ... *it ... }
+
+#define VECTOR_MIN_CAP 8
+
+#define vecForEach(it, v) for (typeof((v)->items) it = (v)->items; it < (v)->items + (v)->len; it++)
+
+#define DEFINE_VECTOR(name, type)                                                          \
+struct name {                                                                              \
+    type* items;                                                                           \
+    uint64_t len;                                                                          \
+    uint64_t cap;                                                                          \
+};                                                                                         \
+                                                                                           \
+/* Returns 0 (leaving v as it was) if out of memory */                                     \
+static inline int name##Reserve(struct name* v, uint64_t cap) {                            \
+    if (cap <= v->cap)                                                                     \
+        return 1;                                                                          \
+                                                                                           \
+    type* items = realloc(v->items, cap * sizeof(type));                                   \
+    if (!items)                                                                            \
+        return 0;                                                                          \
+                                                                                           \
+    v->items = items;                                                                      \
+    v->cap = cap;                                                                          \
+                                                                                           \
+    return 1;                                                                              \
+}                                                                                          \
+                                                                                           \
+static inline int name##Push(struct name* v, type item) {                                  \
+    if (v->len == v->cap && !name##Reserve(v, v->cap ? v->cap * 2 : VECTOR_MIN_CAP))       \
+        return 0;                                                                          \
+                                                                                           \
+    v->items[v->len++] = item;                                                             \
+                                                                                           \
+    return 1;                                                                              \
+}                                                                                          \
+                                                                                           \
+/* Caller checks len first */                                                              \
+static inline type name##Pop(struct name* v) {                                             \
+    return v->items[--v->len];                                                             \
+}                                                                                          \
+                                                                                           \
+/* Keeps the rest in order */                                                              \
+static inline void name##RemoveAt(struct name* v, uint64_t i) {                            \
+    for (v->len--; i < v->len; i++)                                                        \
+        v->items[i] = v->items[i + 1];                                                     \
+}                                                                                          \
+                                                                                           \
+static inline void name##Free(struct name* v) {                                            \
+    free(v->items);                                                                        \
+    v->items = 0;                                                                          \
+    v->len = v->cap = 0;                                                                   \
+}
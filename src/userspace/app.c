@@ -2,6 +2,7 @@
 
 #include "sys.h"
 #include "../lib/malloc.h"
+#include "../lib/syscall.h"
 
 static uint64_t a;
 static uint64_t b;
@@ -28,11 +29,26 @@ void main() {
         free(l);
     }
 
+    struct sc_timespec before, after;
+    clockGettime(SC_CLOCK_MONOTONIC, &before);
+    sleepNs(250000000);
+    clockGettime(SC_CLOCK_MONOTONIC, &after);
+    printf("Asked to sleep 250000 us; slept %u us\n",
+           ((after.sec - before.sec) * 1000000000 + after.nsec - before.nsec) / 1000);
+
+    nice(SC_BATCH_LEVEL); // Nothing but crunching from here on, so longer slices and out of the shell's way
+
     const uint64_t chunk = 1000000000ull; // Chunk that's not too fast, not too slow, for target system
+    struct sc_timespec start, end;
+    clockGettime(SC_CLOCK_MONOTONIC, &start);
     a = 0;
 
     for (; a < chunk; a++)
         if (a % (chunk / 10) == 0)
             printf("a: %u\n", a);
+
+    clockGettime(SC_CLOCK_MONOTONIC, &end);
+    uint64_t ms = (end.sec - start.sec) * 1000 + end.nsec / 1000000 - start.nsec / 1000000;
+    printf("Counted to %u in %u.%p03u s\n", chunk, ms / 1000, ms % 1000);
     print("Ending without a newline.");
 }
@@ -0,0 +1,23 @@
+#include <stdint.h>
+
+#include "sys.h"
+#include "../lib/syscall.h"
+
+static struct sc_boot_timeline t;
+
+void main() {
+    bootTimeline(&t);
+
+    if (!t.tsc_hz) {
+        print("Boot timeline isn't ready yet (TSC not calibrated); try again in a second.\n");
+        return;
+    }
+
+    printf("Boot timeline (TSC at %u MHz):\n", t.tsc_hz / 1000000);
+    for (uint64_t i = 0; i < t.count && i < SC_BOOT_STAGES; i++) {
+        if (t.us[i] == -1ull)
+            printf("  %p 14s %p 10s\n", t.names[i], "-");
+        else
+            printf("  %p 14s %p 10u us\n", t.names[i], t.us[i]);
+    }
+}
@@ -0,0 +1,26 @@
+#include <stdint.h>
+
+#include "sys.h"
+#include "../lib/malloc.h"
+#include "../lib/syscall.h"
+
+static struct heap_stats s;
+static struct sc_page_stats ps;
+
+void main() {
+    kernelHeapStats(&s);
+
+    printf("Kernel heap: %u K used of %u K (peak %u K)\n", s.used / 1024, s.size / 1024, s.peak / 1024);
+    printf("  %u live allocations, %u made since boot\n", s.allocs, s.total_allocs);
+    printf("  Largest free run: %u K; fragmentation: %u.%u%%\n", s.largest_free / 1024, s.frag / 10, s.frag % 10);
+    printf("  Reallocs: %u in place, %u moved (%u K copied)\n", s.reallocs_in_place, s.reallocs_moved, s.realloc_copied / 1024);
+
+    print("  Free runs by size:\n");
+    for (uint64_t i = 0; i < HEAP_RUN_BUCKETS; i++)
+        if (s.free_runs[i])
+            printf("    %p 10u - %p 10u bytes: %u\n", s.block_size << i, (s.block_size << (i + 1)) - 1, s.free_runs[i]);
+
+    pageStats(&ps);
+    printf("Physical memory: %u MB usable, %u MB managed\n", ps.usable / 1024 / 1024, ps.managed / 1024 / 1024);
+    printf("Process pages: %u of %u %u K pages free (low water mark %u)\n", ps.free, ps.total, ps.page_size / 1024, ps.low);
+}
@@ -1,9 +1,62 @@
 #include <stdint.h>
 
 #include "sys.h"
+#include "../lib/syscall.h"
+
+#define MAX_PROCS 64
+#define MAX_WORK 32
+
+static struct sc_proc ps[MAX_PROCS];
+static struct sc_sched_stats ss;
+static struct sc_work_stats ws[MAX_WORK];
 
 void main() {
-    //for (int i = 0; i < 1; i++)
-    // Sometimes get a new prompt; sometimes don't...  Memory use stays low either way, so I think it's killed correctly either way...
-        print("Procs...\n");
+    uint64_t n = getProcs(ps, MAX_PROCS);
+
+    print("    pid   ppid  nice  level      cpu ms   slices  preempted\n");
+    for (uint64_t i = 0; i < n && i < MAX_PROCS; i++) {
+        struct sc_proc* p = &ps[i];
+        printf("  %p 5u  %p 5u  %p 4u  %p 5u  %p 10u  %p 7u  %p 9u  %s%s\n", p->pid, p->ppid, p->nice, p->level, p->cpu_us / 1000,
+               p->slices, p->preempted, p->level >= SC_BATCH_LEVEL ? "batch" : "interactive", p->running ? " (me)" : "");
+    }
+
+    if (n > MAX_PROCS)
+        printf("  (and %u more)\n", n - MAX_PROCS);
+
+    printf("Processes run by waitloop: %u (this is pid %u)\n", kernelData()->switches, getPid());
+
+    schedStats(&ss);
+    printf("Wakeups: %u (%u switched out a running process early); latency from event to running:\n", ss.wakeups, ss.wake_preempts);
+
+    for (uint64_t i = 0; i < SC_WAKE_BUCKETS; i++) {
+        if (!ss.wake_us[i])
+            continue;
+
+        if (i == 0)
+            printf("  %p 15s us: %u\n", "under 1", ss.wake_us[i]);
+        else if (i == SC_WAKE_BUCKETS - 1)
+            printf("  %p 6u  or more us: %u\n", 1ull << (i - 1), ss.wake_us[i]);
+        else
+            printf("  %p 6u - %p 6u us: %u\n", 1ull << (i - 1), (1ull << i) - 1, ss.wake_us[i]);
+    }
+
+    printf("Timer: %s", ss.tickless ? "one-shot (tickless)" : "periodic, 1000 Hz");
+    if (ss.since_ns >= 1000000) {
+        uint64_t ms = ss.since_ns / 1000000;
+        uint64_t idle = ss.idle_ns / (ss.since_ns / 1000); // Permille
+        printf("; %u interrupts/s; idle %u.%u%% of the time, waking %u times/s\n", ss.timer_irqs * 1000 / ms, idle / 10, idle % 10,
+               ss.idle_wakeups * 1000 / ms);
+    } else {
+        print("\n");
+    }
+
+    n = workStats(ws, MAX_WORK);
+    print("Deferred work:   lane      runs  coalesced  dropped   avg/max wait us    avg/max run us\n");
+    for (uint64_t i = 0; i < n && i < MAX_WORK; i++) {
+        struct sc_work_stats* w = &ws[i];
+        uint64_t runs = w->runs ? w->runs : 1;
+        printf("  %p 15s %p 4s  %p 8u  %p 9u  %p 7u  %p 8u/%p 8u %p 8u/%p 8u\n", w->name, w->lane ? "low" : "high", w->runs,
+               w->coalesced, w->dropped, w->delay_ns / runs / 1000, w->max_delay_ns / 1000, w->run_ns / runs / 1000,
+               w->max_run_ns / 1000);
+    }
 }
@@ -1,6 +1,7 @@
 #include <stdint.h>
 
 #include "sys.h"
+#include "../lib/arena.h"
 #include "../lib/strings.h"
 
 void processInput(char* l) {
@@ -21,15 +22,20 @@ void processInput(char* l) {
 }
 
 void main() {
-    char* s = M_sprintf(" (#%u)\n", stdout);
+    char s[32];
+    char line_mem[256];
+    struct arena lines;
+    initArena(&lines, line_mem, sizeof(line_mem));
+
     printColor("Ready!", 0x0d);
-    printColor(s, 0x0b);
-    free(s);
+    printColor(sprintf(s, sizeof(s), " (#%u)\n", stdout), 0x0b);
 
     for (;;) {
         printColor("\r\3 > ", 0x05);
-        char* l = M_readline();
-        processInput(l);
-        free(l);
+        struct arena_mark m = arenaMark(&lines);
+        char* l = readLine(&lines);
+        if (l)
+            processInput(l);
+        arenaReset(&lines, m);
     }   
 }
@@ -3,7 +3,9 @@
 
 #include "sys.h"
 
+#include "../lib/arena.h"
 #include "../lib/malloc.h"
+#include "../lib/mem.h"
 #include "../lib/strings.h"
 #include "../lib/syscall.h"
 
@@ -15,6 +17,16 @@
    4: runProg
    5: wait
    6: getProcs
+   7: kernelHeapStats
+   8: pageStats
+   9: bootTimeline
+  10: nice
+  11: yield
+  12: schedStats
+  13: clockGettime
+  14: sleepNs
+  15: sleepUntil
+  16: workStats
 
   */
 
@@ -65,16 +77,24 @@ void printf(char* fmt, ...) {
     VARIADIC_PRINT(print);
 }
 
-char* M_readline() {
-    uint64_t len; // Kernel needs to know len in order to know where to put it on stack, so use that knowledge (to malloc needed size)
-    char* l;
+// The kernel leaves the line just below our stack pointer and tells us where and how long it is (it needs len anyway, to know where
+//   to put it), so callers can allocate exactly what's needed and copy it before anything else gets a chance to use that stack
+static inline uint64_t readlineRaw(char** l) {
+    uint64_t len;
 
     asm volatile("\
 \n      mov $3, %%rax                           \
 \n      int $0x80                               \
 \n      mov %%rax, %0                           \
 \n      mov %%rbx, %1                           \
-    ":"=m"(len), "=m"(l));
+    ":"=m"(len), "=m"(*l)::"rax", "rbx");
+
+    return len;
+}
+
+char* M_readline() {
+    char* l;
+    uint64_t len = readlineRaw(&l);
 
     char* s = malloc(len + 1);
     for (uint64_t i = 0; i < len; i++)
@@ -84,22 +104,165 @@ char* M_readline() {
     return s;
 }
 
-struct sc_proc* M_getProcs() {
-    uint64_t size;
-    struct sc_proc *procs;
+// Like M_readline, but the copy goes in a (likely to be reset right after) arena
+char* readLine(struct arena* a) {
+    char* l;
+    uint64_t len = readlineRaw(&l);
+
+    char* s = arenaAlloc(a, len + 1);
+    if (!s)
+        return 0;
+
+    memcpy(s, l, len);
+    s[len] = 0;
+
+    return s;
+}
 
+uint64_t getProcs(struct sc_proc* ps, uint64_t max) {
+    uint64_t n;
     asm volatile("\
 \n      mov $6, %%rax                           \
+\n      mov %1, %%rbx                           \
+\n      mov %2, %%rcx                           \
 \n      int $0x80                               \
 \n      mov %%rax, %0                           \
-\n      mov %%rbx, %1                           \
-    ":"=m"(size), "=m"(procs));
+    ":"=m"(n):"m"(ps),"m"(max):"rax", "rbx", "rcx", "memory");
 
-    struct sc_proc *p = malloc(size * sizeof(struct sc_proc));
-    for (uint64_t i = 0; i < size; i++)
-        p[i] = procs[i];
+    return n;
+}
 
-    return p;
+void kernelHeapStats(struct heap_stats* s) {
+    asm volatile("\
+\n      mov $7, %%rax                           \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(s):"rax", "rbx", "memory");
+}
+
+void pageStats(struct sc_page_stats* s) {
+    asm volatile("\
+\n      mov $8, %%rax                           \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(s):"rax", "rbx", "memory");
+}
+
+void bootTimeline(struct sc_boot_timeline* t) {
+    asm volatile("\
+\n      mov $9, %%rax                           \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(t):"rax", "rbx", "memory");
+}
+
+uint64_t nice(uint64_t n) {
+    uint64_t old;
+    asm volatile("\
+\n      mov $10, %%rax                          \
+\n      mov %1, %%rbx                           \
+\n      int $0x80                               \
+\n      mov %%rax, %0                           \
+    ":"=m"(old):"m"(n):"rax", "rbx");
+
+    return old;
+}
+
+void yield() {
+    asm volatile("\
+\n      mov $11, %rax                           \
+\n      int $0x80                               \
+    ");
+}
+
+void schedStats(struct sc_sched_stats* s) {
+    asm volatile("\
+\n      mov $12, %%rax                          \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(s):"rax", "rbx", "memory");
+}
+
+static uint64_t sysClockGettime(uint64_t clock, struct sc_timespec* ts) {
+    uint64_t ret;
+    asm volatile("\
+\n      mov $13, %%rax                          \
+\n      mov %1, %%rbx                           \
+\n      mov %2, %%rcx                           \
+\n      int $0x80                               \
+\n      mov %%rax, %0                           \
+    ":"=m"(ret):"m"(clock),"m"(ts):"rax", "rbx", "rcx", "memory");
+
+    return ret;
+}
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+// From the kernel data page when the kernel's clock is the TSC, which is about the cost of the rdtsc; else the syscall
+uint64_t clockGettime(uint64_t clock, struct sc_timespec* ts) {
+    struct sc_kdata* kd = (struct sc_kdata*) SC_KDATA_ADDR;
+    uint64_t s, ns, mult;
+
+    if (clock != SC_CLOCK_MONOTONIC && clock != SC_CLOCK_REALTIME)
+        return -1ull;
+
+    do {
+        s = __atomic_load_n(&kd->seq, __ATOMIC_ACQUIRE);
+        mult = kd->clock_mult;
+        ns = kd->clock_ns + (((unsigned __int128) (rdtsc() - kd->clock_tsc) * mult) >> 32);
+        if (clock == SC_CLOCK_REALTIME)
+            ns += kd->realtime_ns;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // The reads above can't slip past the re-check (an acquire load alone would let them)
+    } while (s != __atomic_load_n(&kd->seq, __ATOMIC_ACQUIRE));
+
+    if (!mult)
+        return sysClockGettime(clock, ts);
+
+    ts->sec = ns / 1000000000;
+    ts->nsec = ns % 1000000000;
+
+    return 0;
+}
+
+void sleepNs(uint64_t ns) {
+    asm volatile("\
+\n      mov $14, %%rax                          \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(ns):"rax", "rbx");
+}
+
+void sleepUntil(uint64_t ns) {
+    asm volatile("\
+\n      mov $15, %%rax                          \
+\n      mov %0, %%rbx                           \
+\n      int $0x80                               \
+    "::"m"(ns):"rax", "rbx");
+}
+
+uint64_t workStats(struct sc_work_stats* ws, uint64_t max) {
+    uint64_t n;
+    asm volatile("\
+\n      mov $16, %%rax                          \
+\n      mov %1, %%rbx                           \
+\n      mov %2, %%rcx                           \
+\n      int $0x80                               \
+\n      mov %%rax, %0                           \
+    ":"=m"(n):"m"(ws),"m"(max):"rax", "rbx", "rcx", "memory");
+
+    return n;
+}
+
+uint64_t getPid() {
+    return ((struct sc_kdata*) SC_KDATA_ADDR)->pid;
+}
+
+struct sc_kdata* kernelData() {
+    return (struct sc_kdata*) SC_KDATA_ADDR;
 }
 
 uint64_t stdout;
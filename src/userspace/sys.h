@@ -2,13 +2,39 @@
 
 #include <stdint.h>
 
+struct arena;
+struct heap_stats;
+struct sc_page_stats;
+struct sc_proc;
+struct sc_sched_stats;
+struct sc_boot_timeline;
+struct sc_timespec;
+struct sc_kdata;
+struct sc_work_stats;
+
 void print(char* s);
 void printf(char* fmt, ...);
 void printColor(char* s, uint8_t c);
 char* M_readline();
+char* readLine(struct arena* a);
 
 void exit();
 void wait(uint64_t pid);
 uint64_t runProg(char* s);
+void kernelHeapStats(struct heap_stats* s);
+void pageStats(struct sc_page_stats* s);
+void bootTimeline(struct sc_boot_timeline* t);
+uint64_t getProcs(struct sc_proc* ps, uint64_t max); // Fills in up to max, parents before children; returns how many there are
+uint64_t nice(uint64_t n); // Lowers our priority level to n (0 is highest; from SC_BATCH_LEVEL on is batch), never raises it; returns the old one
+void yield();
+void schedStats(struct sc_sched_stats* s);
+uint64_t clockGettime(uint64_t clock, struct sc_timespec* ts); // SC_CLOCK_*; 0, or -1 for an unknown clock
+void sleepNs(uint64_t ns);
+void sleepUntil(uint64_t ns); // Until SC_CLOCK_MONOTONIC reaches ns
+uint64_t workStats(struct sc_work_stats* ws, uint64_t max); // Fills in up to max; returns how many there are
+
+// No syscall for these; they read the kernel data page
+uint64_t getPid();
+struct sc_kdata* kernelData();
 
 extern uint64_t stdout;